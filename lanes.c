@@ -0,0 +1,298 @@
+#include "stream.h"
+
+//Lane kernel of the stream mode (sudoku-serial --stream -l lanes): a solver thread works on up to 32
+//puzzles at once. The masks and cells of all the puzzles are stored lane by lane (structure of arrays),
+//so the candidate sweep over the grid runs for every lane in the same vector instructions.
+//Each step then makes one move per lane, with its own search: the cell with the fewest candidates is
+//filled (a forced move when there is a single one), a dead end backtracks to the last branching of
+//that lane only, and a lane whose puzzle is solved or refuted takes the next puzzle of the input.
+
+#define MAX_LANES 32
+#define NO_EMPTY  99    //candidate count of a full grid
+
+//state of a lane saved when its search branches
+typedef struct{
+    int cell;
+    uint32_t remaining;     //candidates of the cell still to try
+}Branch;
+
+typedef struct{
+    int width, m, v;
+    uint32_t full;
+    int *cell_row, *cell_col, *cell_box;
+
+    //lane l of unit u is at [u * width + l]
+    uint32_t *rows, *cols, *boxes;
+    uint8_t *board;
+
+    //per lane search
+    Job *job[MAX_LANES];
+    int depth[MAX_LANES];
+    Branch *branches;       //v branches per lane
+    uint8_t *saved_board;   //v cells per branch
+    uint32_t *saved_masks;  //3 * m masks per branch
+
+    //results of the sweep
+    int best_n[MAX_LANES], best_cell[MAX_LANES];
+}Lanes;
+
+void lanes_init(Lanes *ls, int width, int r_size);
+void lanes_free(Lanes *ls);
+int lanes_load(Lanes *ls, int l, Job *job);
+void lanes_sweep(Lanes *ls);
+int lanes_step(Lanes *ls, int l);
+void lanes_assign(Lanes *ls, int l, int cell, int num);
+void lanes_save(Lanes *ls, int l, int cell, uint32_t remaining);
+int lanes_backtrack(Lanes *ls, int l);
+void lanes_retire(Lanes *ls, int l, int solved);
+
+//popcount written with shifts and masks so that it vectorizes without a popcount instruction
+static inline int bit_count(uint32_t x){
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0f0f0f0f;
+    return (x * 0x01010101) >> 24;
+}
+
+//solver stage of the lane kernel: keep the lanes busy with puzzles from in until in is closed and empty
+void lanes_solve(JobQueue *in, JobQueue *out, int width, int r_size){
+    int l, active = 0, closed = 0;
+    Job *job;
+    Lanes ls;
+
+    lanes_init(&ls, width, r_size);
+
+    while(1){
+        //refill the free lanes, waiting for input only when no lane has work
+        for(l = 0; l < ls.width && !closed; l++){
+            if(ls.job[l] != NULL)
+                continue;
+            if(active)
+                job = queue_try_pop(in);
+            else if((job = queue_pop(in)) == NULL)
+                closed = 1;
+            if(job == NULL)
+                break;
+            if(lanes_load(&ls, l, job))
+                active++;
+            else
+                queue_push(out, job);
+        }
+        if(!active){
+            if(closed)
+                break;
+            continue;
+        }
+
+        lanes_sweep(&ls);
+        for(l = 0; l < ls.width; l++)
+            if(ls.job[l] != NULL && lanes_step(&ls, l)){
+                queue_push(out, ls.job[l]);
+                ls.job[l] = NULL;
+                active--;
+            }
+    }
+
+    lanes_free(&ls);
+}
+
+void lanes_init(Lanes *ls, int width, int r_size){
+    int i, r = r_size, m = r_size * r_size, v = m * m;
+
+    ls->width = width < 1 ? 1 : width > MAX_LANES ? MAX_LANES : width;
+    ls->m = m;
+    ls->v = v;
+    ls->full = m == 32 ? 0xffffffff : (1u << m) - 1;
+
+    ls->cell_row = (int*) malloc(v * sizeof(int));
+    ls->cell_col = (int*) malloc(v * sizeof(int));
+    ls->cell_box = (int*) malloc(v * sizeof(int));
+    for(i = 0; i < v; i++){
+        ls->cell_row[i] = i / m;
+        ls->cell_col[i] = i % m;
+        ls->cell_box[i] = r * (i / m / r) + (i % m) / r;
+    }
+
+    ls->rows = (uint32_t*) calloc(m * ls->width, sizeof(uint32_t));
+    ls->cols = (uint32_t*) calloc(m * ls->width, sizeof(uint32_t));
+    ls->boxes = (uint32_t*) calloc(m * ls->width, sizeof(uint32_t));
+    ls->board = (uint8_t*) calloc(v * ls->width, sizeof(uint8_t));
+
+    ls->branches = (Branch*) malloc((size_t) ls->width * v * sizeof(Branch));
+    ls->saved_board = (uint8_t*) malloc((size_t) ls->width * v * v * sizeof(uint8_t));
+    ls->saved_masks = (uint32_t*) malloc((size_t) ls->width * v * 3 * m * sizeof(uint32_t));
+
+    for(i = 0; i < ls->width; i++){
+        ls->job[i] = NULL;
+        ls->depth[i] = 0;
+    }
+}
+
+void lanes_free(Lanes *ls){
+    free(ls->cell_row);
+    free(ls->cell_col);
+    free(ls->cell_box);
+    free(ls->rows);
+    free(ls->cols);
+    free(ls->boxes);
+    free(ls->board);
+    free(ls->branches);
+    free(ls->saved_board);
+    free(ls->saved_masks);
+}
+
+//put a puzzle in lane l, returns 0 (and marks the job unsolved) when two clues already conflict
+int lanes_load(Lanes *ls, int l, Job *job){
+    int i, w = ls->width;
+    uint32_t bit;
+
+    ls->job[l] = job;
+    ls->depth[l] = 0;
+    for(i = 0; i < ls->m; i++)
+        ls->rows[i * w + l] = ls->cols[i * w + l] = ls->boxes[i * w + l] = 0;
+
+    for(i = 0; i < ls->v; i++){
+        ls->board[i * w + l] = job->sudoku[i];
+        if(!job->sudoku[i])
+            continue;
+        bit = 1u << (job->sudoku[i] - 1);
+        if((ls->rows[ls->cell_row[i] * w + l] | ls->cols[ls->cell_col[i] * w + l] | ls->boxes[ls->cell_box[i] * w + l]) & bit){
+            ls->job[l] = NULL;
+            job->solved = 0;
+            return 0;
+        }
+        lanes_assign(ls, l, i, job->sudoku[i]);
+    }
+    return 1;
+}
+
+//candidate sweep of every lane: for each one the empty cell with the fewest candidates
+//(0 for a dead end, NO_EMPTY when the grid is full)
+void lanes_sweep(Lanes *ls){
+    int i, l, w = ls->width;
+    int best_n[MAX_LANES], best_cell[MAX_LANES];
+    uint32_t full = ls->full;
+
+    for(l = 0; l < w; l++){
+        best_n[l] = NO_EMPTY;
+        best_cell[l] = 0;
+    }
+
+    for(i = 0; i < ls->v; i++){
+        const uint32_t *rm = ls->rows + ls->cell_row[i] * w;
+        const uint32_t *cm = ls->cols + ls->cell_col[i] * w;
+        const uint32_t *bm = ls->boxes + ls->cell_box[i] * w;
+        const uint8_t *cell = ls->board + i * w;
+
+        #pragma omp simd
+        for(l = 0; l < w; l++){
+            int n = bit_count(~(rm[l] | cm[l] | bm[l]) & full);
+            n = cell[l] ? NO_EMPTY : n;
+            best_cell[l] = n < best_n[l] ? i : best_cell[l];
+            best_n[l] = n < best_n[l] ? n : best_n[l];
+        }
+    }
+
+    for(l = 0; l < w; l++){
+        ls->best_n[l] = best_n[l];
+        ls->best_cell[l] = best_cell[l];
+    }
+}
+
+//one move of lane l after a sweep, returns 1 when its puzzle is solved or has no solution
+int lanes_step(Lanes *ls, int l){
+    int cell = ls->best_cell[l], w = ls->width, num;
+    uint32_t cand;
+
+    if(ls->best_n[l] == NO_EMPTY){
+        lanes_retire(ls, l, 1);
+        return 1;
+    }
+
+    if(ls->best_n[l] == 0){
+        if(lanes_backtrack(ls, l))
+            return 0;
+        lanes_retire(ls, l, 0);
+        return 1;
+    }
+
+    //fill the cell with its smallest candidate, the others are kept for backtracking
+    cand = ~(ls->rows[ls->cell_row[cell] * w + l] | ls->cols[ls->cell_col[cell] * w + l] | ls->boxes[ls->cell_box[cell] * w + l]) & ls->full;
+    num = __builtin_ctz(cand);
+    cand &= cand - 1;
+    if(cand)
+        lanes_save(ls, l, cell, cand);
+    lanes_assign(ls, l, cell, num + 1);
+
+    return 0;
+}
+
+void lanes_assign(Lanes *ls, int l, int cell, int num){
+    int w = ls->width;
+    uint32_t bit = 1u << (num - 1);
+
+    ls->board[cell * w + l] = num;
+    ls->rows[ls->cell_row[cell] * w + l] |= bit;
+    ls->cols[ls->cell_col[cell] * w + l] |= bit;
+    ls->boxes[ls->cell_box[cell] * w + l] |= bit;
+}
+
+//copy the grid and masks of lane l before it branches on cell
+void lanes_save(Lanes *ls, int l, int cell, uint32_t remaining){
+    int i, w = ls->width, m = ls->m, v = ls->v, d = l * v + ls->depth[l]++;
+    uint8_t *board = ls->saved_board + (size_t) d * v;
+    uint32_t *masks = ls->saved_masks + (size_t) d * 3 * m;
+
+    ls->branches[d].cell = cell;
+    ls->branches[d].remaining = remaining;
+    for(i = 0; i < v; i++)
+        board[i] = ls->board[i * w + l];
+    for(i = 0; i < m; i++){
+        masks[i] = ls->rows[i * w + l];
+        masks[m + i] = ls->cols[i * w + l];
+        masks[2 * m + i] = ls->boxes[i * w + l];
+    }
+}
+
+//restore the last branching of lane l and try its next candidate, returns 0 when there is none left
+int lanes_backtrack(Lanes *ls, int l){
+    int i, w = ls->width, m = ls->m, v = ls->v, d, num;
+    uint8_t *board;
+    uint32_t *masks;
+    Branch *b;
+
+    if(!ls->depth[l])
+        return 0;
+
+    d = l * v + ls->depth[l] - 1;
+    b = &ls->branches[d];
+    board = ls->saved_board + (size_t) d * v;
+    masks = ls->saved_masks + (size_t) d * 3 * m;
+
+    for(i = 0; i < v; i++)
+        ls->board[i * w + l] = board[i];
+    for(i = 0; i < m; i++){
+        ls->rows[i * w + l] = masks[i];
+        ls->cols[i * w + l] = masks[m + i];
+        ls->boxes[i * w + l] = masks[2 * m + i];
+    }
+
+    num = __builtin_ctz(b->remaining);
+    b->remaining &= b->remaining - 1;
+    if(!b->remaining)
+        ls->depth[l]--;
+    lanes_assign(ls, l, b->cell, num + 1);
+
+    return 1;
+}
+
+//copy the solution of lane l back into its job
+void lanes_retire(Lanes *ls, int l, int solved){
+    int i, w = ls->width;
+    Job *job = ls->job[l];
+
+    job->solved = solved;
+    if(solved)
+        for(i = 0; i < ls->v; i++)
+            job->sudoku[i] = ls->board[i * w + l];
+}
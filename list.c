@@ -5,6 +5,7 @@ List* init_list(void){
     newList -> head = NULL;
     newList -> tail = NULL;
     newList->len = 0;
+    newList->spare = NULL;
 
     return newList;
 }
@@ -19,7 +20,13 @@ ListNode* newNode(Item this){
 }
 
 void insert_head(List* list, Item this){
-    ListNode* node = newNode(this);
+    ListNode* node = list->spare;
+
+    if(node != NULL){
+        list->spare = node->next;
+        node->this = this;
+    }else
+        node = newNode(this);
 
     if (list->len) {
         node->next = list->head;
@@ -44,10 +51,10 @@ Item pop_head(List* list){
     else
         list->head = list->tail = NULL;
 
-    node->next = node->prev = NULL;
-
     item = node -> this;
-    free(node);
+    node->prev = NULL;
+    node->next = list->spare;
+    list->spare = node;
     return item;
 }
 
@@ -61,13 +68,30 @@ Item pop_tail(List *list) {
     else
         list->tail = list->head = NULL;
 
-    node->next = node->prev = NULL;
-
     item = node-> this;
-    free(node);
+    node->prev = NULL;
+    node->next = list->spare;
+    list->spare = node;
     return item;
 }
 
+//remove every item, their nodes are kept for later insertions
+void clear_list(List *list){
+    while(list->head != NULL)
+        pop_head(list);
+}
+
+void free_list(List *list){
+    ListNode *node;
+
+    clear_list(list);
+    while((node = list->spare) != NULL){
+        list->spare = node->next;
+        free(node);
+    }
+    free(list);
+}
+
 void print_list(List* list){
     ListNode *aux;
 
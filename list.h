@@ -1,3 +1,6 @@
+#ifndef LIST_H
+#define LIST_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,6 +21,7 @@ typedef struct{
     ListNode *head;
     ListNode *tail;
     int len;
+    ListNode *spare;    //nodes of popped items, reused by the next insertions
 }List;
 
 List * init_list(void);
@@ -25,4 +29,8 @@ ListNode* newNode(Item this);
 void insert_head(List* list, Item this);
 Item pop_head(List* list);
 Item pop_tail(List *list);
+void clear_list(List *list);
+void free_list(List *list);
 void print_list(List* list);
+
+#endif
@@ -0,0 +1,896 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "mpi-sim.h"
+
+//sudoku-sim: runs n virtual ranks of sudoku-mpi as threads over an in-process message layer.
+//
+//Every message is delivered after latency + bytes / bandwidth. In the free-running mode the ranks
+//run concurrently and the delay is real time. In the deterministic mode (-d) a single rank runs at
+//a time: each rank has a virtual clock advanced by the node expansions of its search (node_cost, -e)
+//and by every MPI call (call_cost, -c), and the rank with the earliest clock runs next, so two runs with the same
+//parameters deliver the same messages in the same order and produce the same trace. A rank keeps
+//running until it is one time slice (-s) ahead of the others: a slice no longer than the latency
+//gives the exact message order, a longer one trades that accuracy for far fewer thread switches.
+
+#define R_READY   0 //runnable
+#define R_WAIT    1 //blocked until its wake time or a new message
+#define R_BLOCKED 2 //blocked until a message arrives or a collective completes
+#define R_DONE    3
+
+#define C_BARRIER   0
+#define C_BCAST     1
+#define C_ALLREDUCE 2
+#define C_ALLGATHER 3
+#define C_SPLIT     4
+
+typedef struct SimMsg{
+    int src, tag, count;    //world rank of the sender, count in bytes
+    MPI_Comm comm;          //a message only matches the receives made on its communicator
+    double arrival;
+    struct SimMsg *next;
+    char data[];
+}SimMsg;
+
+typedef struct{
+    SimMsg *inbox;          //sorted by arrival time, in sending order for equal times
+    double clock;           //virtual time in microseconds (deterministic mode)
+    double wake;
+    int state;
+    pthread_cond_t cond;
+}SimRank;
+
+//communicator and the collective operation in progress on it
+typedef struct{
+    int size, *members;     //world ranks ordered by rank in the communicator
+    int arrived;
+    long generation;
+    int kind, count, type, op, root;
+    double latest;          //latest clock among the members that arrived
+    const void **send;
+    void **recv;
+    int *color, *key;
+    MPI_Comm **out;
+}SimComm;
+
+//window as seen by one rank: the segments of all the members of its communicator
+struct SimWin{
+    MPI_Comm comm;
+    int size, disp_unit, shared;
+    char **base;
+    MPI_Aint *bytes;
+};
+
+void* sim_rank_thread(void *arg);
+int sim_rank_main(int argc, char *argv[]);
+void sim_schedule(int me);
+void sim_tick(int me);
+void sim_work(long nodes);
+double sim_now(int me);
+double wall_us(void);
+SimMsg* sim_match(int me, int source, int tag, MPI_Comm comm);
+SimMsg* sim_wait_match(int me, int source, int tag, MPI_Comm comm);
+void sim_collective(MPI_Comm comm, int kind, const void *send, void *recv, int count, int type, int op, int root, int color, int key, MPI_Comm *out);
+void sim_complete(SimComm *c);
+MPI_Comm sim_new_comm(int size, int *members);
+int sim_comm_index(SimComm *c, int world_rank);
+int type_size(MPI_Datatype type);
+void trace_event(int me, int src, int tag, int count);
+MPI_Win sim_win_create(MPI_Aint size, int disp_unit, MPI_Comm comm, void *baseptr, int shared);
+char* sim_rma_begin(MPI_Win win, int target, MPI_Aint disp, int bytes);
+void sim_rma_end(MPI_Win win, int target, int bytes);
+void sim_apply(void *target, const void *origin, MPI_Datatype type, MPI_Op op);
+
+struct{
+    int n, deterministic;
+    double latency, bandwidth, call_cost;   //microseconds, bytes per microsecond, microseconds
+    double node_cost;       //microseconds per node expansion of the search
+    double slice;           //deterministic mode: how far the running rank may get ahead of the others
+    pthread_mutex_t lock;
+    SimRank *ranks;
+    double *last_arrival;   //per (source, destination) channel, messages never overtake each other
+    int current;            //deterministic mode: the rank allowed to run
+    int alive;
+    SimComm **comms;
+    int nr_comms, cap_comms;
+    long nr_msgs, nr_bytes, nr_rma;
+    double makespan, start;
+    int argc;
+    char **argv;
+    uint64_t trace_hash;
+    FILE *trace;
+}sim;
+
+__thread int sim_self;
+
+int main(int argc, char *argv[]){
+    int i, opt;
+    char *trace_path = NULL;
+    pthread_t *threads;
+    pthread_condattr_t attr;
+
+    sim.n = 4;
+    sim.latency = 1.0;
+    sim.bandwidth = 0;
+    sim.call_cost = 0.2;
+    sim.node_cost = 0.15;
+    sim.slice = 50.0;
+
+    //options end at the input file, the rest is the command line of sudoku-mpi
+    while((opt = getopt(argc, argv, "+n:l:b:c:e:s:dt:")) != -1){
+        switch(opt){
+            case 'n': sim.n = atoi(optarg); break;
+            case 'l': sim.latency = atof(optarg); break;
+            case 'b': sim.bandwidth = atof(optarg); break;
+            case 'c': sim.call_cost = atof(optarg); break;
+            case 'e': sim.node_cost = atof(optarg); break;
+            case 's': sim.slice = atof(optarg); break;
+            case 'd': sim.deterministic = 1; break;
+            case 't': trace_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: sudoku-sim [-n ranks] [-l latency_us] [-b bytes_per_us] [-c call_cost_us] [-e node_cost_us] [-s slice_us] [-d] [-t trace] <input> [protocol [ranks_per_node]]\n");
+                return 1;
+        }
+    }
+    if(sim.slice < sim.latency)
+        sim.slice = sim.latency;
+    if(optind >= argc || sim.n < 1){
+        fprintf(stderr, "usage: sudoku-sim [-n ranks] [-l latency_us] [-b bytes_per_us] [-c call_cost_us] [-e node_cost_us] [-s slice_us] [-d] [-t trace] <input> [protocol [ranks_per_node]]\n");
+        return 1;
+    }
+    if(trace_path != NULL && (sim.trace = fopen(trace_path, "w")) == NULL){
+        fprintf(stderr, "unable to open file %s\n", trace_path);
+        return 1;
+    }
+
+    sim.argc = argc - optind + 1;
+    sim.argv = (char**) malloc((sim.argc + 1) * sizeof(char*));
+    sim.argv[0] = "sudoku-mpi";
+    for(i = 1; i < sim.argc; i++)
+        sim.argv[i] = argv[optind + i - 1];
+    sim.argv[sim.argc] = NULL;
+
+    //timed waits of the free-running mode are on the monotonic clock
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&sim.lock, NULL);
+    sim.ranks = (SimRank*) calloc(sim.n, sizeof(SimRank));
+    sim.last_arrival = (double*) calloc((size_t) sim.n * sim.n, sizeof(double));
+    for(i = 0; i < sim.n; i++)
+        pthread_cond_init(&sim.ranks[i].cond, &attr);
+    pthread_condattr_destroy(&attr);
+    sim.alive = sim.n;
+    sim.trace_hash = 14695981039346656037ULL;
+
+    int *world = (int*) malloc(sim.n * sizeof(int));
+    for(i = 0; i < sim.n; i++)
+        world[i] = i;
+    sim_new_comm(sim.n, world);
+
+    sim.start = wall_us();
+
+    threads = (pthread_t*) malloc(sim.n * sizeof(pthread_t));
+    for(i = 0; i < sim.n; i++){
+        int *id = (int*) malloc(sizeof(int));
+        *id = i;
+        if(pthread_create(&threads[i], NULL, sim_rank_thread, id)){
+            fprintf(stderr, "unable to start virtual rank %d\n", i);
+            exit(1);
+        }
+    }
+    for(i = 0; i < sim.n; i++)
+        pthread_join(threads[i], NULL);
+
+    if(!sim.deterministic)
+        sim.makespan = wall_us() - sim.start;
+
+    fflush(stdout);
+    fprintf(stderr, "sim: %d ranks, %s, latency %g us, bandwidth %g B/us, call %g us, node %g us, %ld messages, %ld bytes, %ld RMA operations, makespan %f s, trace %016llx\n",
+            sim.n, sim.deterministic ? "deterministic" : "free-running", sim.latency, sim.bandwidth, sim.call_cost, sim.node_cost,
+            sim.nr_msgs, sim.nr_bytes, sim.nr_rma, sim.makespan * 1e-6, (unsigned long long) sim.trace_hash);
+
+    if(sim.trace != NULL)
+        fclose(sim.trace);
+    for(i = 0; i < sim.n; i++){
+        while(sim.ranks[i].inbox != NULL){
+            SimMsg *m = sim.ranks[i].inbox;
+            sim.ranks[i].inbox = m->next;
+            free(m);
+        }
+        pthread_cond_destroy(&sim.ranks[i].cond);
+    }
+    for(i = 0; i < sim.nr_comms; i++){
+        SimComm *c = sim.comms[i];
+        free(c->members);
+        free(c->send);
+        free(c->recv);
+        free(c->color);
+        free(c->key);
+        free(c->out);
+        free(c);
+    }
+    free(sim.comms);
+    free(sim.ranks);
+    free(sim.last_arrival);
+    free(threads);
+    free(sim.argv);
+    pthread_mutex_destroy(&sim.lock);
+
+    return 0;
+}
+
+void* sim_rank_thread(void *arg){
+    SimRank *r;
+
+    sim_self = *(int*) arg;
+    free(arg);
+    r = &sim.ranks[sim_self];
+
+    //deterministic mode: the whole rank, not only its MPI calls, runs when it holds the baton
+    pthread_mutex_lock(&sim.lock);
+    while(sim.deterministic && sim.current != sim_self)
+        pthread_cond_wait(&r->cond, &sim.lock);
+    pthread_mutex_unlock(&sim.lock);
+
+    sim_rank_main(sim.argc, sim.argv);
+
+    pthread_mutex_lock(&sim.lock);
+    r->state = R_DONE;
+    sim.alive--;
+    if(sim.deterministic && r->clock > sim.makespan)
+        sim.makespan = r->clock;
+    if(sim.deterministic && sim.alive)
+        sim_schedule(sim_self);
+    pthread_mutex_unlock(&sim.lock);
+
+    return NULL;
+}
+
+//deterministic mode, called with the lock held: pass the baton to the rank with the earliest time and
+//wait to get it back. The running rank keeps it while its clock is less than one slice ahead of the
+//others: with a slice of one latency no message sent by them can arrive before that.
+void sim_schedule(int me){
+    int i, next = -1;
+    double t, best = 0;
+    SimRank *r, *self = &sim.ranks[me];
+
+    for(i = 0; i < sim.n; i++){
+        r = &sim.ranks[i];
+        if(i == me || r->state == R_BLOCKED || r->state == R_DONE)
+            continue;
+        t = r->state == R_WAIT && r->wake > r->clock ? r->wake : r->clock;
+        if(next < 0 || t < best){
+            best = t;
+            next = i;
+        }
+    }
+
+    if(self->state == R_READY && (next < 0 || self->clock <= best || self->clock < best + sim.slice))
+        return;
+    if(self->state == R_WAIT && (next < 0 || self->wake <= best)){
+        if(self->wake > self->clock)
+            self->clock = self->wake;
+        self->state = R_READY;
+        return;
+    }
+    if(next < 0){
+        if(self->state == R_DONE)
+            return;
+        fprintf(stderr, "sim: deadlock, every live rank is blocked (rank %d)\n", me);
+        exit(1);
+    }
+
+    r = &sim.ranks[next];
+    if(r->state == R_WAIT){
+        if(r->wake > r->clock)
+            r->clock = r->wake;
+        r->state = R_READY;
+    }
+    sim.current = next;
+    pthread_cond_signal(&r->cond);
+
+    if(self->state == R_DONE)
+        return;
+    while(sim.current != me)
+        pthread_cond_wait(&self->cond, &sim.lock);
+}
+
+//every MPI call costs call_cost of virtual time
+void sim_tick(int me){
+    if(sim.deterministic)
+        sim.ranks[me].clock += sim.call_cost;
+}
+
+//node expansions of the search between two MPI calls, only the running rank touches its own clock.
+//In the free-running mode they take real time
+void sim_work(long nodes){
+    if(sim.deterministic)
+        sim.ranks[sim_self].clock += nodes * sim.node_cost;
+}
+
+double sim_now(int me){
+    return sim.deterministic ? sim.ranks[me].clock : wall_us() - sim.start;
+}
+
+double wall_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+//first message of the inbox matching source and tag, whether it has arrived or not
+SimMsg* sim_match(int me, int source, int tag, MPI_Comm comm){
+    SimMsg *m;
+
+    if(source != MPI_ANY_SOURCE)
+        source = sim.comms[comm]->members[source];
+    for(m = sim.ranks[me].inbox; m != NULL; m = m->next)
+        if(m->comm == comm && (source == MPI_ANY_SOURCE || m->src == source) && (tag == MPI_ANY_TAG || m->tag == tag))
+            return m;
+    return NULL;
+}
+
+//block until a matching message has arrived, called with the lock held
+SimMsg* sim_wait_match(int me, int source, int tag, MPI_Comm comm){
+    SimMsg *m;
+    SimRank *self = &sim.ranks[me];
+    struct timespec ts;
+    double t;
+
+    while(1){
+        m = sim_match(me, source, tag, comm);
+        t = sim_now(me);
+        if(m != NULL && m->arrival <= t)
+            return m;
+
+        if(sim.deterministic){
+            if(m != NULL){
+                self->state = R_WAIT;
+                self->wake = m->arrival;
+            }else
+                self->state = R_BLOCKED;
+            sim_schedule(me);
+        }else if(m != NULL){
+            t = (m->arrival + sim.start) * 1e-6;
+            ts.tv_sec = (time_t) t;
+            ts.tv_nsec = (long) ((t - ts.tv_sec) * 1e9);
+            pthread_cond_timedwait(&self->cond, &sim.lock, &ts);
+        }else
+            pthread_cond_wait(&self->cond, &sim.lock);
+    }
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm){
+    int bytes = count * type_size(type);
+    SimMsg *m = (SimMsg*) malloc(sizeof(SimMsg) + bytes), **pos;
+    SimRank *r;
+
+    memcpy(m->data, buf, bytes);
+    m->src = sim_self;
+    m->tag = tag;
+    m->count = bytes;
+    m->comm = comm;
+
+    pthread_mutex_lock(&sim.lock);
+    sim_tick(sim_self);
+
+    //dest is a rank of comm, the channels and inboxes are those of the world ranks
+    dest = sim.comms[comm]->members[dest];
+    r = &sim.ranks[dest];
+
+    m->arrival = sim_now(sim_self) + sim.latency + (sim.bandwidth > 0 ? bytes / sim.bandwidth : 0);
+    if(m->arrival < sim.last_arrival[(size_t) sim_self * sim.n + dest])
+        m->arrival = sim.last_arrival[(size_t) sim_self * sim.n + dest];
+    sim.last_arrival[(size_t) sim_self * sim.n + dest] = m->arrival;
+
+    for(pos = &r->inbox; *pos != NULL && (*pos)->arrival <= m->arrival; pos = &(*pos)->next);
+    m->next = *pos;
+    *pos = m;
+
+    sim.nr_msgs++;
+    sim.nr_bytes += bytes;
+
+    if(sim.deterministic){
+        if(r->state == R_BLOCKED){
+            r->state = R_WAIT;
+            r->wake = m->arrival;
+        }else if(r->state == R_WAIT && m->arrival < r->wake)
+            r->wake = m->arrival;
+        sim_schedule(sim_self);
+    }else
+        pthread_cond_signal(&r->cond);
+
+    pthread_mutex_unlock(&sim.lock);
+    return MPI_SUCCESS;
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status){
+    SimMsg *m;
+
+    pthread_mutex_lock(&sim.lock);
+    sim_tick(sim_self);
+
+    m = sim_match(sim_self, source, tag, comm);
+    *flag = m != NULL && m->arrival <= sim_now(sim_self);
+    if(*flag){
+        status->MPI_SOURCE = sim_comm_index(sim.comms[comm], m->src);
+        status->MPI_TAG = m->tag;
+        status->count = m->count;
+    }
+
+    if(sim.deterministic)
+        sim_schedule(sim_self);
+    pthread_mutex_unlock(&sim.lock);
+    return MPI_SUCCESS;
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status){
+    SimMsg *m;
+
+    pthread_mutex_lock(&sim.lock);
+    sim_tick(sim_self);
+
+    m = sim_wait_match(sim_self, source, tag, comm);
+    status->MPI_SOURCE = sim_comm_index(sim.comms[comm], m->src);
+    status->MPI_TAG = m->tag;
+    status->count = m->count;
+
+    pthread_mutex_unlock(&sim.lock);
+    return MPI_SUCCESS;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status){
+    SimMsg *m, **pos;
+    int bytes = count * type_size(type);
+
+    pthread_mutex_lock(&sim.lock);
+    sim_tick(sim_self);
+
+    m = sim_wait_match(sim_self, source, tag, comm);
+    for(pos = &sim.ranks[sim_self].inbox; *pos != m; pos = &(*pos)->next);
+    *pos = m->next;
+    trace_event(sim_self, m->src, m->tag, m->count);
+
+    pthread_mutex_unlock(&sim.lock);
+
+    if(m->count < bytes)
+        bytes = m->count;
+    memcpy(buf, m->data, bytes);
+    if(status != NULL){
+        status->MPI_SOURCE = sim_comm_index(sim.comms[comm], m->src);
+        status->MPI_TAG = m->tag;
+        status->count = m->count;
+    }
+    free(m);
+
+    return MPI_SUCCESS;
+}
+
+int MPI_Get_count(const MPI_Status *status, MPI_Datatype type, int *count){
+    *count = status->count / type_size(type);
+    return MPI_SUCCESS;
+}
+
+//every received message goes into the trace hash (FNV-1a) and, when asked, the trace file.
+//RMA operations are traced at the target with tag -1
+void trace_event(int me, int src, int tag, int count){
+    int i, event[4] = {src, me, tag, count};
+    unsigned char *b = (unsigned char*) event;
+
+    for(i = 0; i < (int) sizeof(event); i++){
+        sim.trace_hash ^= b[i];
+        sim.trace_hash *= 1099511628211ULL;
+    }
+    if(sim.trace != NULL)
+        fprintf(sim.trace, "%.3f %d %d %d %d\n", sim_now(sim_self), src, me, tag, count);
+}
+
+int MPI_Init(int *argc, char ***argv){
+    (void) argc;
+    (void) argv;
+    return MPI_SUCCESS;
+}
+
+int MPI_Finalize(void){
+    return MPI_SUCCESS;
+}
+
+double MPI_Wtime(void){
+    double t;
+
+    pthread_mutex_lock(&sim.lock);
+    t = sim_now(sim_self);
+    pthread_mutex_unlock(&sim.lock);
+
+    return t * 1e-6;
+}
+
+int MPI_Comm_rank(MPI_Comm comm, int *rank){
+    pthread_mutex_lock(&sim.lock);
+    *rank = sim_comm_index(sim.comms[comm], sim_self);
+    pthread_mutex_unlock(&sim.lock);
+    return MPI_SUCCESS;
+}
+
+int MPI_Comm_size(MPI_Comm comm, int *size){
+    pthread_mutex_lock(&sim.lock);
+    *size = sim.comms[comm]->size;
+    pthread_mutex_unlock(&sim.lock);
+    return MPI_SUCCESS;
+}
+
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm){
+    sim_collective(comm, C_SPLIT, NULL, NULL, 0, MPI_INT, 0, 0, color, key, newcomm);
+    return MPI_SUCCESS;
+}
+
+//all the virtual ranks share the memory of one host
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm){
+    (void) split_type;
+    (void) info;
+    return MPI_Comm_split(comm, 0, key, newcomm);
+}
+
+//communicators live until the end of the simulation
+int MPI_Comm_free(MPI_Comm *comm){
+    (void) comm;
+    return MPI_SUCCESS;
+}
+
+int MPI_Barrier(MPI_Comm comm){
+    sim_collective(comm, C_BARRIER, NULL, NULL, 0, MPI_INT, 0, 0, 0, 0, NULL);
+    return MPI_SUCCESS;
+}
+
+int MPI_Bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm){
+    sim_collective(comm, C_BCAST, buf, buf, count, type, 0, root, 0, 0, NULL);
+    return MPI_SUCCESS;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm){
+    sim_collective(comm, C_ALLREDUCE, sendbuf, recvbuf, count, type, op, 0, 0, 0, NULL);
+    return MPI_SUCCESS;
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm){
+    (void) recvcount;
+    (void) recvtype;
+    sim_collective(comm, C_ALLGATHER, sendbuf, recvbuf, sendcount, sendtype, 0, 0, 0, 0, NULL);
+    return MPI_SUCCESS;
+}
+
+//every member deposits its arguments, the last one to arrive performs the operation for all of them
+//and the others resume one latency after the latest arrival
+void sim_collective(MPI_Comm comm, int kind, const void *send, void *recv, int count, int type, int op, int root, int color, int key, MPI_Comm *out){
+    SimComm *c;
+    SimRank *self = &sim.ranks[sim_self];
+    int i, idx;
+    long generation;
+
+    pthread_mutex_lock(&sim.lock);
+    sim_tick(sim_self);
+    c = sim.comms[comm];
+    idx = sim_comm_index(c, sim_self);
+
+    if(!c->arrived || sim_now(sim_self) > c->latest)
+        c->latest = sim_now(sim_self);
+    c->kind = kind;
+    c->count = count;
+    c->type = type;
+    c->op = op;
+    c->root = root;
+    c->send[idx] = send;
+    c->recv[idx] = recv;
+    c->color[idx] = color;
+    c->key[idx] = key;
+    c->out[idx] = out;
+    generation = c->generation;
+
+    if(++c->arrived == c->size){
+        sim_complete(c);
+        c->arrived = 0;
+        c->generation++;
+        for(i = 0; i < c->size; i++){
+            SimRank *r = &sim.ranks[c->members[i]];
+            if(sim.deterministic && c->members[i] != sim_self){
+                r->state = R_WAIT;
+                r->wake = c->latest + sim.latency;
+            }else if(!sim.deterministic)
+                pthread_cond_signal(&r->cond);
+        }
+        if(sim.deterministic){
+            self->clock = c->latest + sim.latency;
+            sim_schedule(sim_self);
+        }
+    }else{
+        while(c->generation == generation){
+            if(sim.deterministic){
+                self->state = R_BLOCKED;
+                sim_schedule(sim_self);
+            }else
+                pthread_cond_wait(&self->cond, &sim.lock);
+        }
+    }
+
+    pthread_mutex_unlock(&sim.lock);
+}
+
+void sim_complete(SimComm *c){
+    int i, j, size = type_size(c->type), bytes = c->count * size;
+
+    switch(c->kind){
+        case C_BCAST:
+            for(i = 0; i < c->size; i++)
+                if(i != c->root)
+                    memcpy(c->recv[i], c->send[c->root], bytes);
+            break;
+
+        case C_ALLGATHER:
+            for(i = 0; i < c->size; i++)
+                for(j = 0; j < c->size; j++)
+                    memcpy((char*) c->recv[i] + j * bytes, c->send[j], bytes);
+            break;
+
+        case C_ALLREDUCE:
+            for(j = 0; j < c->count; j++){
+                long acc = 0, v;
+                for(i = 0; i < c->size; i++){
+                    v = c->type == MPI_LONG ? ((const long*) c->send[i])[j] : ((const int*) c->send[i])[j];
+                    if(c->op == MPI_SUM || i == 0)
+                        acc = c->op == MPI_SUM ? acc + v : v;
+                    else if(v > acc)
+                        acc = v;
+                }
+                for(i = 0; i < c->size; i++){
+                    if(c->type == MPI_LONG)
+                        ((long*) c->recv[i])[j] = acc;
+                    else
+                        ((int*) c->recv[i])[j] = (int) acc;
+                }
+            }
+            break;
+
+        case C_SPLIT:
+            //one new communicator per color, in increasing color order, members ordered by key then rank
+            for(i = 0; i < c->size; i++){
+                int k, n = 0, *members, done = 0;
+                for(j = 0; j < i; j++)
+                    if(c->color[j] == c->color[i])
+                        done = 1;
+                if(done)
+                    continue;
+                members = (int*) malloc(c->size * sizeof(int));
+                for(j = i; j < c->size; j++){
+                    if(c->color[j] != c->color[i])
+                        continue;
+                    for(k = n; k > 0 && c->key[members[k-1]] > c->key[j]; k--)
+                        members[k] = members[k-1];
+                    members[k] = j;
+                    n++;
+                }
+                MPI_Comm id = sim_new_comm(n, members);
+                for(k = 0; k < n; k++){
+                    *c->out[members[k]] = id;
+                    members[k] = c->members[members[k]];
+                }
+            }
+            break;
+    }
+}
+
+//members are world ranks, the array is owned by the new communicator
+MPI_Comm sim_new_comm(int size, int *members){
+    SimComm *c = (SimComm*) calloc(1, sizeof(SimComm));
+
+    c->size = size;
+    c->members = members;
+    c->send = (const void**) calloc(size, sizeof(void*));
+    c->recv = (void**) calloc(size, sizeof(void*));
+    c->color = (int*) calloc(size, sizeof(int));
+    c->key = (int*) calloc(size, sizeof(int));
+    c->out = (MPI_Comm**) calloc(size, sizeof(MPI_Comm*));
+
+    if(sim.nr_comms == sim.cap_comms){
+        sim.cap_comms = sim.cap_comms ? 2 * sim.cap_comms : 16;
+        sim.comms = (SimComm**) realloc(sim.comms, sim.cap_comms * sizeof(SimComm*));
+    }
+    sim.comms[sim.nr_comms] = c;
+    return sim.nr_comms++;
+}
+
+int sim_comm_index(SimComm *c, int world_rank){
+    int i;
+
+    for(i = 0; i < c->size; i++)
+        if(c->members[i] == world_rank)
+            return i;
+    return -1;
+}
+
+int type_size(MPI_Datatype type){
+    return type == MPI_LONG ? sizeof(long) : sizeof(int);
+}
+
+//windows: every rank allocates its own segment and learns the segments of the others with an allgather.
+//A shared window is read and written directly; the operations on the other windows are applied at once
+//under the simulator lock and cost one round trip (plus the transfer time of MPI_Get) to the caller.
+MPI_Win sim_win_create(MPI_Aint size, int disp_unit, MPI_Comm comm, void *baseptr, int shared){
+    MPI_Win win = (MPI_Win) malloc(sizeof(struct SimWin));
+    long mine[2];
+    long *all;
+    int i;
+
+    MPI_Comm_size(comm, &win->size);
+    win->comm = comm;
+    win->disp_unit = disp_unit;
+    win->shared = shared;
+    win->base = (char**) malloc(win->size * sizeof(char*));
+    win->bytes = (MPI_Aint*) malloc(win->size * sizeof(MPI_Aint));
+
+    mine[0] = (long) calloc(size > 0 ? size : 1, 1);
+    mine[1] = size;
+    all = (long*) malloc(2 * win->size * sizeof(long));
+    MPI_Allgather(mine, 2, MPI_LONG, all, 2, MPI_LONG, comm);
+    for(i = 0; i < win->size; i++){
+        win->base[i] = (char*) all[2 * i];
+        win->bytes[i] = all[2 * i + 1];
+    }
+    free(all);
+
+    *(void**) baseptr = (void*) mine[0];
+    return win;
+}
+
+int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm, void *baseptr, MPI_Win *win){
+    (void) info;
+    *win = sim_win_create(size, disp_unit, comm, baseptr, 0);
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm, void *baseptr, MPI_Win *win){
+    (void) info;
+    *win = sim_win_create(size, disp_unit, comm, baseptr, 1);
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_shared_query(MPI_Win win, int rank, MPI_Aint *size, int *disp_unit, void *baseptr){
+    *size = win->bytes[rank];
+    *disp_unit = win->disp_unit;
+    *(void**) baseptr = win->base[rank];
+    return MPI_SUCCESS;
+}
+
+//nobody may touch the segments once every member has entered the call
+int MPI_Win_free(MPI_Win *win){
+    int me;
+
+    MPI_Comm_rank((*win)->comm, &me);
+    MPI_Barrier((*win)->comm);
+    free((*win)->base[me]);
+    free((*win)->base);
+    free((*win)->bytes);
+    free(*win);
+    *win = NULL;
+
+    return MPI_SUCCESS;
+}
+
+//the operations complete before returning: locks, flushes and syncs have nothing left to do
+int MPI_Win_lock_all(int assert, MPI_Win win){
+    (void) assert;
+    (void) win;
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_unlock_all(MPI_Win win){
+    (void) win;
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_sync(MPI_Win win){
+    (void) win;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_flush(int rank, MPI_Win win){
+    (void) rank;
+    (void) win;
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_flush_all(MPI_Win win){
+    (void) win;
+    return MPI_SUCCESS;
+}
+
+//start an operation on the segment of target: take the lock and return the address of the data
+char* sim_rma_begin(MPI_Win win, int target, MPI_Aint disp, int bytes){
+    pthread_mutex_lock(&sim.lock);
+    sim_tick(sim_self);
+    sim.nr_rma++;
+    if(sim.comms[win->comm]->members[target] != sim_self)
+        sim.nr_bytes += bytes;
+    trace_event(sim.comms[win->comm]->members[target], sim_self, -1, bytes);
+    return win->base[target] + disp * win->disp_unit;
+}
+
+//finish an operation: charge the round trip to the caller and let the others run
+void sim_rma_end(MPI_Win win, int target, int bytes){
+    double cost = 0;
+    struct timespec ts;
+
+    if(sim.comms[win->comm]->members[target] != sim_self)
+        cost = 2 * sim.latency + (sim.bandwidth > 0 ? bytes / sim.bandwidth : 0);
+
+    if(sim.deterministic){
+        sim.ranks[sim_self].clock += cost;
+        sim_schedule(sim_self);
+    }
+    pthread_mutex_unlock(&sim.lock);
+
+    if(!sim.deterministic && cost > 0){
+        ts.tv_sec = (time_t) (cost * 1e-6);
+        ts.tv_nsec = (long) ((cost - ts.tv_sec * 1e6) * 1e3);
+        nanosleep(&ts, NULL);
+    }
+}
+
+void sim_apply(void *target, const void *origin, MPI_Datatype type, MPI_Op op){
+    if(op == MPI_NO_OP)
+        return;
+    if(type == MPI_LONG)
+        *(long*) target = op == MPI_SUM ? *(long*) target + *(const long*) origin : *(const long*) origin;
+    else
+        *(int*) target = op == MPI_SUM ? *(int*) target + *(const int*) origin : *(const int*) origin;
+}
+
+int MPI_Get(void *origin, int origin_count, MPI_Datatype origin_type, int target, MPI_Aint disp, int target_count, MPI_Datatype target_type, MPI_Win win){
+    int bytes = target_count * type_size(target_type);
+
+    //the origin buffer is taken to match the target, as it does in sudoku-mpi
+    (void) origin_count;
+    (void) origin_type;
+    memcpy(origin, sim_rma_begin(win, target, disp, bytes), bytes);
+    sim_rma_end(win, target, bytes);
+    return MPI_SUCCESS;
+}
+
+int MPI_Accumulate(const void *origin, int origin_count, MPI_Datatype origin_type, int target, MPI_Aint disp, int target_count, MPI_Datatype target_type, MPI_Op op, MPI_Win win){
+    int i, size = type_size(target_type);
+    char *data;
+
+    (void) origin_count;
+    (void) origin_type;
+    data = sim_rma_begin(win, target, disp, target_count * size);
+
+    for(i = 0; i < target_count; i++)
+        sim_apply(data + i * size, (const char*) origin + i * size, target_type, op);
+    sim_rma_end(win, target, target_count * size);
+    return MPI_SUCCESS;
+}
+
+int MPI_Fetch_and_op(const void *origin, void *result, MPI_Datatype type, int target, MPI_Aint disp, MPI_Op op, MPI_Win win){
+    int size = type_size(type);
+    char *data = sim_rma_begin(win, target, disp, size);
+
+    memcpy(result, data, size);
+    sim_apply(data, origin, type, op);
+    sim_rma_end(win, target, size);
+    return MPI_SUCCESS;
+}
+
+int MPI_Compare_and_swap(const void *origin, const void *compare, void *result, MPI_Datatype type, int target, MPI_Aint disp, MPI_Win win){
+    int size = type_size(type);
+    char *data = sim_rma_begin(win, target, disp, size);
+
+    memcpy(result, data, size);
+    if(!memcmp(data, compare, size))
+        memcpy(data, origin, size);
+    sim_rma_end(win, target, size);
+    return MPI_SUCCESS;
+}
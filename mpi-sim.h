@@ -0,0 +1,78 @@
+#ifndef MPI_SIM_H
+#define MPI_SIM_H
+
+//In-process stand-in for the MPI calls used by sudoku-mpi: every rank is a thread of sudoku-sim.
+//Only the point-to-point messages, collectives and RMA window operations on which the solver relies
+//are provided.
+
+#include <pthread.h>
+
+//process globals of the solver become per virtual rank
+#define SIM_LOCAL __thread
+
+//charge node expansions of the search to the virtual clock of the calling rank
+void sim_work(long nodes);
+
+typedef int MPI_Comm;
+typedef int MPI_Datatype;
+typedef int MPI_Op;
+typedef int MPI_Info;
+typedef long MPI_Aint;
+typedef struct SimWin* MPI_Win;
+
+typedef struct{
+    int MPI_SOURCE;
+    int MPI_TAG;
+    int count;      //bytes
+}MPI_Status;
+
+#define MPI_SUCCESS     0
+#define MPI_COMM_WORLD  0
+#define MPI_INFO_NULL   0
+#define MPI_ANY_SOURCE  -1
+#define MPI_ANY_TAG     -1
+
+#define MPI_INT  1
+#define MPI_LONG 2
+
+#define MPI_SUM     1
+#define MPI_MAX     2
+#define MPI_REPLACE 3
+#define MPI_NO_OP   4
+
+#define MPI_COMM_TYPE_SHARED 1
+#define MPI_MODE_NOCHECK     1
+
+int MPI_Init(int *argc, char ***argv);
+int MPI_Finalize(void);
+int MPI_Comm_rank(MPI_Comm comm, int *rank);
+int MPI_Comm_size(MPI_Comm comm, int *size);
+int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm);
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm);
+int MPI_Comm_free(MPI_Comm *comm);
+int MPI_Send(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm);
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status);
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status);
+int MPI_Recv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status);
+int MPI_Get_count(const MPI_Status *status, MPI_Datatype type, int *count);
+int MPI_Barrier(MPI_Comm comm);
+int MPI_Bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm);
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm);
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm);
+double MPI_Wtime(void);
+
+int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm, void *baseptr, MPI_Win *win);
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm, void *baseptr, MPI_Win *win);
+int MPI_Win_shared_query(MPI_Win win, int rank, MPI_Aint *size, int *disp_unit, void *baseptr);
+int MPI_Win_free(MPI_Win *win);
+int MPI_Win_lock_all(int assert, MPI_Win win);
+int MPI_Win_unlock_all(MPI_Win win);
+int MPI_Win_sync(MPI_Win win);
+int MPI_Win_flush(int rank, MPI_Win win);
+int MPI_Win_flush_all(MPI_Win win);
+int MPI_Get(void *origin, int origin_count, MPI_Datatype origin_type, int target, MPI_Aint disp, int target_count, MPI_Datatype target_type, MPI_Win win);
+int MPI_Accumulate(const void *origin, int origin_count, MPI_Datatype origin_type, int target, MPI_Aint disp, int target_count, MPI_Datatype target_type, MPI_Op op, MPI_Win win);
+int MPI_Fetch_and_op(const void *origin, void *result, MPI_Datatype type, int target, MPI_Aint disp, MPI_Op op, MPI_Win win);
+int MPI_Compare_and_swap(const void *origin, const void *compare, void *result, MPI_Datatype type, int target, MPI_Aint disp, MPI_Win win);
+
+#endif
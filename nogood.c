@@ -0,0 +1,256 @@
+#include "steal.h"
+#include "nogood.h"
+
+//Nogood cache of the distributed search: every subtree a process searched to the end without a
+//solution is recorded, and a hypothesis leading to a board recorded before is not expanded again.
+//
+//The subtree of a hypothesis only depends on its cell and on the row, column and box masks once it
+//is placed (the cells before it are all filled), so the key of a board is a Zobrist hash of the
+//mask bits and of the cell. Boards reached through different fillings of the previous cells share
+//the same key. The table is direct mapped, a slot keeps the larger of two refuted subtrees.
+//
+//Refutations are found with the same bookkeeping as the search: the expansions in progress are kept
+//on a stack, and the subtree of one of them is over when a hypothesis of the same or an earlier cell
+//is popped, or when the work list runs out. It is only recorded if none of its hypotheses was given
+//to another process. Large refuted subtrees are sent to the other processes in TAG_NOGOOD batches on
+//a communicator of their own, so that the protocols never see them.
+
+#define NOGOOD_MIN_NODES   64   //smaller refuted subtrees are cheaper to search again than to keep
+#define NOGOOD_SHARE_NODES 1024 //refuted subtrees from that size on are sent to the other processes
+#define NOGOOD_BATCH       32   //nogoods per TAG_NOGOOD message
+#define NOGOOD_POLL        256  //lookups between two checks for the nogoods of the other processes
+
+typedef struct{
+    uint64_t key;           //0 for an empty slot
+    long nodes;             //size of the refuted subtree
+}Nogood;
+
+//an expansion whose subtree is being searched
+typedef struct{
+    int cell, len;          //cell of the hypothesis, length of the work list once it was popped
+    uint64_t hash;          //hash of the masks with the hypothesis placed
+    long given, nodes;      //ctx->nr_given and ctx->nr_iterations at the expansion
+}Frame;
+
+uint64_t nogood_masks_hash(SudokuCtx *ctx);
+uint64_t nogood_toggle(SudokuCtx *ctx, Item hyp);
+void nogood_refuted(SudokuCtx *ctx, Frame *f);
+void nogood_store(uint64_t key, long nodes);
+void nogood_share(void);
+void nogood_receive(void);
+
+SIM_LOCAL MPI_Comm nogood_comm;
+SIM_LOCAL Nogood *ng_table;
+SIM_LOCAL long ng_size = 0;
+SIM_LOCAL uint64_t *ng_keys;    //m_size keys per row, then per column and per box, then one per cell
+SIM_LOCAL Frame *ng_stack;
+SIM_LOCAL int ng_depth;
+SIM_LOCAL long *ng_out;         //(key, nodes) pairs waiting to be sent
+SIM_LOCAL int ng_nr_out;
+SIM_LOCAL int ng_ticks;
+SIM_LOCAL long ng_batches_out, ng_batches_in;  //TAG_NOGOOD messages sent to every other process, received
+SIM_LOCAL NogoodStats ng_stats;
+
+static inline uint64_t splitmix64(uint64_t *state){
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+//a table of at least entries slots, 0 entries only counts the nodes of the search
+void nogood_setup(SudokuCtx *ctx, long entries){
+    int i, nr_keys = 3 * ctx->m_size * ctx->m_size + ctx->v_size;
+    uint64_t seed = 0;
+
+    for(ng_size = entries > 0 ? 1 : 0; ng_size && ng_size < entries; ng_size <<= 1);
+    ng_table = (Nogood*) calloc(ng_size, sizeof(Nogood));
+
+    //the same keys on every process, so that their nogoods can be exchanged
+    ng_keys = (uint64_t*) malloc(nr_keys * sizeof(uint64_t));
+    for(i = 0; i < nr_keys; i++)
+        ng_keys[i] = splitmix64(&seed);
+
+    ng_stack = (Frame*) malloc(ctx->v_size * sizeof(Frame));
+    ng_out = (long*) malloc(2 * NOGOOD_BATCH * sizeof(long));
+    ng_depth = ng_nr_out = ng_ticks = 0;
+    ng_batches_out = ng_batches_in = 0;
+    memset(&ng_stats, 0, sizeof(ng_stats));
+
+    MPI_Comm_split(MPI_COMM_WORLD, 0, rank, &nogood_comm);
+}
+
+//collect the nogoods still on their way and print the totals of all the processes
+void nogood_teardown(SudokuCtx *ctx){
+    long mine[7], all[7], expected;
+    MPI_Status status;
+    long bytes = ng_size * sizeof(Nogood) + (3 * ctx->m_size * ctx->m_size + ctx->v_size) * sizeof(uint64_t) + ctx->v_size * sizeof(Frame);
+
+    //every batch goes to all the other processes: wait until those of the others are all in
+    MPI_Allreduce(&ng_batches_out, &expected, 1, MPI_LONG, MPI_SUM, nogood_comm);
+    expected -= ng_batches_out;
+    while(ng_batches_in < expected){
+        MPI_Probe(MPI_ANY_SOURCE, TAG_NOGOOD, nogood_comm, &status);
+        nogood_receive();
+    }
+
+    mine[0] = ctx->nr_iterations;
+    mine[1] = ng_stats.lookups;
+    mine[2] = ng_stats.hits;
+    mine[3] = ng_stats.saved;
+    mine[4] = ng_stats.stored;
+    mine[5] = ng_stats.shared;
+    mine[6] = ng_stats.received;
+    MPI_Allreduce(mine, all, 7, MPI_LONG, MPI_SUM, nogood_comm);
+
+    if(!rank){
+        if(ng_size)
+            printf("\n nogood: %ld nodes, %ld lookups, %ld hits (%.2f%%) standing for %ld nodes, %ld refuted subtrees stored, %ld shared, %ld received, %ld entries (%ld KB) per process\n",
+                   all[0], all[1], all[2], all[1] ? 100.0 * all[2] / all[1] : 0.0, all[3], all[4], all[5], all[6], ng_size, bytes / 1024);
+        else
+            printf("\n nogood: %ld nodes, cache off\n", all[0]);
+    }
+
+    MPI_Comm_free(&nogood_comm);
+    free(ng_table);
+    free(ng_keys);
+    free(ng_stack);
+    free(ng_out);
+    ng_size = 0;
+}
+
+//the prune hook of the search: returns 1 when the board of hyp was refuted before
+int nogood_prune(SudokuCtx *ctx, Item hyp){
+    uint64_t hash, key;
+    Nogood *slot;
+    Frame *f;
+
+    if(++ng_ticks == NOGOOD_POLL){
+        ng_ticks = 0;
+        nogood_receive();
+    }
+
+    //the subtrees of the expansions at or after the cell of hyp are over
+    while(ng_depth && ng_stack[ng_depth - 1].cell >= hyp.cell)
+        nogood_refuted(ctx, &ng_stack[--ng_depth]);
+
+    //the hash is carried over from the parent, and only computed from the masks at the root of a subtree
+    hash = (ng_depth ? ng_stack[ng_depth - 1].hash : nogood_masks_hash(ctx)) ^ nogood_toggle(ctx, hyp);
+    key = hash ^ ng_keys[3 * ctx->m_size * ctx->m_size + hyp.cell];
+
+    ng_stats.lookups++;
+    slot = &ng_table[key & (ng_size - 1)];
+    if(key && slot->key == key){
+        ng_stats.hits++;
+        ng_stats.saved += slot->nodes;
+        return 1;
+    }
+
+    f = &ng_stack[ng_depth++];
+    f->cell = hyp.cell;
+    f->len = ctx->work->len;
+    f->hash = hash;
+    f->given = ctx->nr_given;
+    f->nodes = ctx->nr_iterations;
+    return 0;
+}
+
+//the work list is empty: the subtrees of all the expansions in progress are over
+void nogood_exhausted(SudokuCtx *ctx){
+    while(ng_depth)
+        nogood_refuted(ctx, &ng_stack[--ng_depth]);
+
+    //an idle process has time to send what it found
+    if(ng_nr_out)
+        nogood_share();
+}
+
+//the subtree of f was searched to the end without a solution
+void nogood_refuted(SudokuCtx *ctx, Frame *f){
+    long nodes = ctx->nr_iterations - f->nodes;
+    uint64_t key = f->hash ^ ng_keys[3 * ctx->m_size * ctx->m_size + f->cell];
+
+    //hypotheses are given away from the bottom of the work list, past the first f->len of them they came from this subtree
+    if(ctx->nr_given - f->given > f->len || nodes < NOGOOD_MIN_NODES || !key)
+        return;
+
+    nogood_store(key, nodes);
+    ng_stats.stored++;
+
+    if(nodes >= NOGOOD_SHARE_NODES && p > 1){
+        ng_out[2 * ng_nr_out] = (long) key;
+        ng_out[2 * ng_nr_out + 1] = nodes;
+        if(++ng_nr_out == NOGOOD_BATCH)
+            nogood_share();
+    }
+}
+
+void nogood_store(uint64_t key, long nodes){
+    Nogood *slot = &ng_table[key & (ng_size - 1)];
+
+    if(slot->key != key && slot->nodes > nodes)
+        return;
+    slot->key = key;
+    if(slot->nodes < nodes)
+        slot->nodes = nodes;
+}
+
+//send the pending nogoods to every other process
+void nogood_share(void){
+    int i;
+
+    for(i = 0; i < p; i++){
+        if(i == rank)
+            continue;
+        MPI_Send(ng_out, 2 * ng_nr_out, MPI_LONG, i, TAG_NOGOOD, nogood_comm);
+        count_send(i, 2 * ng_nr_out * sizeof(long) / sizeof(int));
+    }
+    ng_stats.shared += ng_nr_out;
+    ng_batches_out++;
+    ng_nr_out = 0;
+}
+
+void nogood_receive(void){
+    int i, flag, count;
+    long buf[2 * NOGOOD_BATCH];
+    MPI_Status status;
+
+    while(1){
+        MPI_Iprobe(MPI_ANY_SOURCE, TAG_NOGOOD, nogood_comm, &flag, &status);
+        if(!flag)
+            break;
+        MPI_Recv(buf, 2 * NOGOOD_BATCH, MPI_LONG, status.MPI_SOURCE, TAG_NOGOOD, nogood_comm, &status);
+        MPI_Get_count(&status, MPI_LONG, &count);
+
+        if(ng_size)
+            for(i = 0; i + 1 < count; i += 2)
+                nogood_store((uint64_t) buf[i], buf[i + 1]);
+        ng_stats.received += count / 2;
+        ng_batches_in++;
+    }
+}
+
+//hash of the masks of the board
+uint64_t nogood_masks_hash(SudokuCtx *ctx){
+    int u, m = ctx->m_size;
+    uint64_t hash = 0, bits;
+
+    for(u = 0; u < m; u++){
+        for(bits = ctx->rows_mask[u]; bits; bits &= bits - 1)
+            hash ^= ng_keys[u * m + __builtin_ctzll(bits)];
+        for(bits = ctx->cols_mask[u]; bits; bits &= bits - 1)
+            hash ^= ng_keys[(m + u) * m + __builtin_ctzll(bits)];
+        for(bits = ctx->boxes_mask[u]; bits; bits &= bits - 1)
+            hash ^= ng_keys[(2 * m + u) * m + __builtin_ctzll(bits)];
+    }
+    return hash;
+}
+
+//change of the hash when hyp is placed: the bit of its number in its row, column and box
+uint64_t nogood_toggle(SudokuCtx *ctx, Item hyp){
+    int m = ctx->m_size, r = ctx->r_size, n = hyp.num - 1;
+    int row = hyp.cell / m, col = hyp.cell % m, box = r * (row / r) + col / r;
+
+    return ng_keys[row * m + n] ^ ng_keys[(m + col) * m + n] ^ ng_keys[(2 * m + box) * m + n];
+}
@@ -0,0 +1,16 @@
+#define NOGOOD_ENTRIES (1 << 14) //default size of the cache, set with --nogood
+
+//per process counters of the nogood cache
+typedef struct{
+    long lookups;           //hypotheses looked up before their expansion
+    long hits;              //hypotheses skipped because their board was refuted before
+    long saved;             //nodes of the refuted subtrees the hits stand for
+    long stored;            //subtrees refuted by this process and recorded in its table
+    long shared;            //of those, sent to the other processes
+    long received;          //refuted subtrees received from the other processes
+}NogoodStats;
+
+void nogood_setup(SudokuCtx *ctx, long entries);
+void nogood_teardown(SudokuCtx *ctx);
+int nogood_prune(SudokuCtx *ctx, Item hyp);
+void nogood_exhausted(SudokuCtx *ctx);
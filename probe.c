@@ -0,0 +1,81 @@
+#include "steal.h"
+#include "probe.h"
+
+//Difficulty probe run by rank 0 before the distributed search: most puzzles are solved (or shown to
+//have no solution) by a short serial search, and then the polling, ring and reductions of the
+//work stealing search cost more than the search itself.
+
+void probe_defaults(ProbeLimits *limits){
+    limits->budget = 20000;
+    limits->min_clues = 0.15;
+    limits->max_density = 0.75;
+}
+
+//read one of the --budget, --min-clues and --max-density options, returns 0 when name is none of them
+//or the value is not a whole number (budget) or a fraction between 0 and 1 (the other two)
+int probe_option(const char *name, const char *value, ProbeLimits *limits){
+    char *end;
+    double fraction;
+
+    if(!strcmp(name, "--budget")){
+        limits->budget = strtol(value, &end, 10);
+        return end != value && !*end && limits->budget >= 0;
+    }
+
+    fraction = strtod(value, &end);
+    if(end == value || *end || !(fraction >= 0 && fraction <= 1))
+        return 0;
+    if(!strcmp(name, "--min-clues"))
+        limits->min_clues = fraction;
+    else if(!strcmp(name, "--max-density"))
+        limits->max_density = fraction;
+    else
+        return 0;
+
+    return 1;
+}
+
+//the limits given as options must keep the minimum under the maximum, returns 0 otherwise
+int probe_check(ProbeLimits *limits){
+    return limits->min_clues <= limits->max_density;
+}
+
+//measure the puzzle and, unless it looks too open, try to finish it with a serial search of at most
+//limits->budget node expansions. On success the solution is written in sudoku
+void probe_sudoku(SudokuCtx *ctx, int r_size, int *sudoku, ProbeLimits *limits, Probe *probe){
+    int i, val, empty = 0;
+    long candidates = 0;
+
+    sudoku_start(ctx, r_size, sudoku);
+
+    //candidate density: share of the numbers still allowed in the empty cells by the initial masks
+    for(i = 0; i < ctx->v_size; i++){
+        if(sudoku[i])
+            continue;
+        empty++;
+        for(val = 1; val <= ctx->m_size; val++)
+            if(sudoku_is_safe_num(ctx, i, val))
+                candidates++;
+    }
+
+    probe->cells = ctx->v_size;
+    probe->clues = ctx->v_size - empty;
+    probe->density = empty ? (double) candidates / ((double) empty * ctx->m_size) : 0;
+    probe->nodes = 0;
+    probe->result = -1;
+
+    //the trial is the library solver with a node budget
+    if(limits->budget > 0 && probe->clues >= limits->min_clues * ctx->v_size && probe->density <= limits->max_density){
+        ctx->budget = limits->budget;
+        probe->result = sudoku_solve(ctx, r_size, sudoku);
+        probe->nodes = ctx->nr_iterations;
+        ctx->budget = 0;
+    }
+    probe->local = probe->result >= 0;
+}
+
+void probe_log(ProbeLimits *limits, Probe *probe){
+    printf("\n probe: clues %d/%d (min %.2f), density %.3f (max %.2f), trial %ld of %ld nodes --> %s\n",
+           probe->clues, probe->cells, limits->min_clues, probe->density, limits->max_density, probe->nodes, limits->budget,
+           probe->local ? "solved locally" : "distributed search");
+}
@@ -0,0 +1,21 @@
+//thresholds of the difficulty probe, set with the options of sudoku-mpi
+typedef struct{
+    long budget;            //node expansions allowed to the serial trial solve, 0 always escalates
+    double min_clues;       //fraction of given cells under which the puzzle is escalated without a trial
+    double max_density;     //mean fraction of candidates per empty cell over which it is escalated without a trial
+}ProbeLimits;
+
+//what the probe found out about a puzzle
+typedef struct{
+    int cells, clues;
+    double density;
+    long nodes;             //node expansions of the trial solve
+    int result;             //1 solved, 0 no solution, -1 not decided within the budget or no trial
+    int local;              //1 when the puzzle is finished by the trial, 0 when every rank has to search
+}Probe;
+
+void probe_defaults(ProbeLimits *limits);
+int probe_option(const char *name, const char *value, ProbeLimits *limits);
+int probe_check(ProbeLimits *limits);
+void probe_sudoku(SudokuCtx *ctx, int r_size, int *sudoku, ProbeLimits *limits, Probe *probe);
+void probe_log(ProbeLimits *limits, Probe *probe);
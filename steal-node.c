@@ -0,0 +1,258 @@
+#include "steal.h"
+
+//Hierarchical work stealing: an idle process first asks the processes of its own node, and the
+//job (hypothesis + sudoku) is copied through a shared-memory window instead of a message.
+//Only when every process of the node is idle does the node leader ask processes on other nodes.
+//
+//layout of the shared segment of every process (ints)
+#define SHM_IDLE  0 //idle processes of the node, only used in the segment of the node leader
+#define SHM_REQ   1 //node rank + 1 of the process waiting for a job from this one, 0 if none
+#define SHM_STATE 2 //answer to the request this process made to another one of the node
+#define SHM_SENT  3 //jobs given to processes of other nodes
+#define SHM_RECV  4 //jobs received from processes of other nodes
+#define SHM_JOB   5 //hypothesis followed by the sudoku, same layout as a TAG_HYP message
+
+#define SLOT_WAITING 0
+#define SLOT_FULL    1
+#define SLOT_EMPTY   2
+
+int node_poll_idle(void);
+int node_remote_steal(SudokuCtx *ctx);
+int node_starved(void);
+
+SIM_LOCAL MPI_Win node_win;
+SIM_LOCAL int **node_slot;    //node_slot[i] is the shared segment of the ith process of the node
+
+//state of the termination detection run by rank 0
+SIM_LOCAL int last_pass_valid = 0;
+SIM_LOCAL long last_pass_sent, last_pass_recv;
+
+//allocate the shared segments and map those of the other processes of the node
+void node_setup(SudokuCtx *ctx){
+    int i, disp;
+    int *base;
+    MPI_Aint size;
+
+    MPI_Win_allocate_shared((SHM_JOB + ctx->v_size + 2) * sizeof(int), sizeof(int), MPI_INFO_NULL, node_comm, &base, &node_win);
+    memset(base, 0, (SHM_JOB + ctx->v_size + 2) * sizeof(int));
+
+    node_slot = (int**) malloc(node_size * sizeof(int*));
+    for(i = 0; i < node_size; i++)
+        MPI_Win_shared_query(node_win, i, &size, &disp, &node_slot[i]);
+
+    //the segments are accessed with plain atomics for the whole search (unified memory model)
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, node_win);
+    MPI_Barrier(node_comm);
+}
+
+void node_teardown(void){
+    MPI_Win_unlock_all(node_win);
+    MPI_Win_free(&node_win);
+    free(node_slot);
+}
+
+//called by a busy process between two node expansions
+int node_serve_requests(SudokuCtx *ctx){
+    int *me = node_slot[node_rank];
+    int req = __atomic_load_n(&me[SHM_REQ], __ATOMIC_ACQUIRE);
+
+    //a process of the node is waiting for a job: copy it straight into its segment
+    if(req){
+        int *thief = node_slot[req - 1];
+
+        if(ctx->work->tail != NULL){
+            pack_work(thief + SHM_JOB, give_work(ctx), ctx);
+
+            //the thief stops being idle before the job is published, so the node is never seen
+            //starved while a job is being handed over
+            __atomic_sub_fetch(&node_slot[0][SHM_IDLE], 1, __ATOMIC_ACQ_REL);
+            __atomic_store_n(&thief[SHM_STATE], SLOT_FULL, __ATOMIC_RELEASE);
+        }else
+            __atomic_store_n(&thief[SHM_STATE], SLOT_EMPTY, __ATOMIC_RELEASE);
+        __atomic_store_n(&me[SHM_REQ], 0, __ATOMIC_RELEASE);
+    }
+
+    //requests from other nodes still arrive as messages
+    return serve_messages(ctx);
+}
+
+//called with an empty work list, returns 1 when new work was inserted in the list and 0 when the search is over
+int node_steal_work(SudokuCtx *ctx){
+    int i, victim, state, expected, got;
+    int *me = node_slot[node_rank];
+
+    __atomic_add_fetch(&node_slot[0][SHM_IDLE], 1, __ATOMIC_ACQ_REL);
+
+    while(1){
+
+        //cycle over the other processes of the node
+        for(i = 1; i < node_size; i++){
+            victim = (node_rank + i) % node_size;
+
+            if(node_poll_idle())
+                return 0;
+
+            //claim the request slot of the victim, skip it if another process is already waiting on it
+            __atomic_store_n(&me[SHM_STATE], SLOT_WAITING, __ATOMIC_RELAXED);
+            expected = 0;
+            if(!__atomic_compare_exchange_n(&node_slot[victim][SHM_REQ], &expected, node_rank + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                continue;
+            stats.steal_requests++;
+
+            //keep refusing requests made to this process while waiting, two idle processes may be asking each other
+            while((state = __atomic_load_n(&me[SHM_STATE], __ATOMIC_ACQUIRE)) == SLOT_WAITING)
+                if(node_poll_idle())
+                    return 0;
+
+            if(state == SLOT_FULL){
+                adopt_work(me + SHM_JOB, ctx);
+                stats.steals_local++;
+                return 1;
+            }
+        }
+
+        if(!node_starved())
+            continue;
+
+        //the whole node is out of work
+        if(node_size == p){
+            //there is no other node: no solution
+            if(rank == 0){
+                send_ring(&rank, TAG_EXIT, -1);
+                return 0;
+            }
+        }else if(node_rank == 0){
+            //the leader looks for work on the other nodes
+            if((got = node_remote_steal(ctx)) >= 0)
+                return got;
+        }
+    }
+}
+
+//one pass of work requests over the processes of the other nodes, run by the leader of a starved node.
+//returns 1 when a job was received, 0 on exit and -1 when no process had work to give
+int node_remote_steal(SudokuCtx *ctx){
+    int i, j, number_amount, all_starved = 1;
+    long sent = 0, recv = 0;
+    MPI_Status status;
+
+    for(j = 1; j < p; j++){
+        i = (rank + j) % p;
+        if(node_of[i] == node_of[rank])
+            continue;
+
+        MPI_Send(&i, 1, MPI_INT, i, TAG_ASK_JOB, MPI_COMM_WORLD);
+        count_send(i, 1);
+        stats.steal_requests++;
+
+        //wait for the answer of the ith process, serving the other messages meanwhile
+        while(1){
+            MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+            MPI_Get_count(&status, MPI_INT, &number_amount);
+            int* number_buf = (int*)malloc(number_amount * sizeof(int));
+            MPI_Recv(number_buf, number_amount, MPI_INT, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD, &status);
+
+            if(status.MPI_TAG == TAG_EXIT){
+                free(number_buf);
+                send_ring(&rank, TAG_EXIT, -1);
+                return 0;
+            }else if(status.MPI_TAG == TAG_ASK_JOB){
+                node_reply_no_work(status.MPI_SOURCE);
+                free(number_buf);
+                continue;
+            }
+
+            //a job: the node is no longer starved
+            if(number_amount == ctx->v_size + 2){
+                __atomic_add_fetch(&node_slot[node_rank][SHM_RECV], 1, __ATOMIC_ACQ_REL);
+                __atomic_sub_fetch(&node_slot[0][SHM_IDLE], 1, __ATOMIC_ACQ_REL);
+                adopt_work(number_buf, ctx);
+                stats.steals_remote++;
+                free(number_buf);
+                return 1;
+            }
+
+            //no work: {-1, starved, jobs sent, jobs received}
+            all_starved &= number_buf[1];
+            sent += number_buf[2];
+            recv += number_buf[3];
+            free(number_buf);
+            break;
+        }
+    }
+
+    if(rank != 0)
+        return -1;
+
+    //termination detection (four counters): two consecutive passes finding every node starved,
+    //with as many cross-node jobs sent as received and no job moved in between
+    for(j = 0; j < node_size; j++){
+        sent += __atomic_load_n(&node_slot[j][SHM_SENT], __ATOMIC_ACQUIRE);
+        recv += __atomic_load_n(&node_slot[j][SHM_RECV], __ATOMIC_ACQUIRE);
+    }
+    all_starved &= node_starved();
+
+    if(all_starved && last_pass_valid && sent == recv && sent == last_pass_sent && recv == last_pass_recv){
+        send_ring(&rank, TAG_EXIT, -1);
+        return 0;
+    }
+    last_pass_valid = all_starved;
+    last_pass_sent = sent;
+    last_pass_recv = recv;
+
+    return -1;
+}
+
+//while idle: refuse the requests of the node, answer those of other nodes and watch for the exit signal
+int node_poll_idle(void){
+    int *me = node_slot[node_rank];
+    int req = __atomic_load_n(&me[SHM_REQ], __ATOMIC_ACQUIRE);
+    int flag = 0, number_amount;
+    MPI_Status status;
+
+    if(req){
+        __atomic_store_n(&node_slot[req - 1][SHM_STATE], SLOT_EMPTY, __ATOMIC_RELEASE);
+        __atomic_store_n(&me[SHM_REQ], 0, __ATOMIC_RELEASE);
+    }
+
+    MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+    if(!flag)
+        return 0;
+
+    MPI_Get_count(&status, MPI_INT, &number_amount);
+    int* number_buf = (int*)malloc(number_amount * sizeof(int));
+    MPI_Recv(number_buf, number_amount, MPI_INT, status.MPI_SOURCE, status.MPI_TAG, MPI_COMM_WORLD, &status);
+    free(number_buf);
+
+    if(status.MPI_TAG == TAG_EXIT){
+        send_ring(&rank, TAG_EXIT, -1);
+        return 1;
+    }
+    if(status.MPI_TAG == TAG_ASK_JOB)
+        node_reply_no_work(status.MPI_SOURCE);
+
+    return 0;
+}
+
+//no work to give: tell the asking process whether this node is starved and how many jobs crossed nodes from here
+void node_reply_no_work(int dest){
+    int *me = node_slot[node_rank];
+    int msg[4];
+
+    msg[0] = -1;
+    msg[1] = node_starved();
+    msg[2] = __atomic_load_n(&me[SHM_SENT], __ATOMIC_ACQUIRE);
+    msg[3] = __atomic_load_n(&me[SHM_RECV], __ATOMIC_ACQUIRE);
+
+    MPI_Send(msg, 4, MPI_INT, dest, TAG_HYP, MPI_COMM_WORLD);
+    count_send(dest, 4);
+}
+
+//a job was sent to a process of another node
+void node_count_donation(void){
+    __atomic_add_fetch(&node_slot[node_rank][SHM_SENT], 1, __ATOMIC_ACQ_REL);
+}
+
+int node_starved(void){
+    return __atomic_load_n(&node_slot[0][SHM_IDLE], __ATOMIC_ACQUIRE) == node_size;
+}
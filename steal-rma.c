@@ -0,0 +1,189 @@
+#include "steal.h"
+
+//One-sided work stealing: every process publishes jobs taken from the bottom of its work list in
+//slots of an MPI RMA window. Thieves claim a slot with a compare-and-swap and copy the job with
+//MPI_Get, so a busy process never receives requests, it only refills its free slots now and then.
+//
+//layout of the window of every process (ints)
+#define RMA_DONE  0 //set in every window when the search is over
+#define RMA_IDLE  1 //processes without work, only used in the window of rank 0
+#define RMA_SLOT0 2 //first slot: state followed by a job (hypothesis + sudoku, same layout as a TAG_HYP message)
+
+#define RMA_SLOTS 4  //jobs published by a process
+#define RMA_POLL  64 //node expansions between two visits of a busy process to its own window
+
+#define SLOT_FREE    0
+#define SLOT_FULL    1
+#define SLOT_CLAIMED 2
+
+#define SLOT_DISP(s) (RMA_SLOT0 + (s) * (ctx->v_size + 3))
+
+int rma_fetch(int target, int disp);
+int rma_cas(int target, int disp, int compare, int value);
+void rma_replace(int target, int disp, int value);
+int rma_idle_add(int value);
+int rma_reclaim(SudokuCtx *ctx);
+
+SIM_LOCAL MPI_Win rma_win;
+SIM_LOCAL int *rma_base;
+SIM_LOCAL int rma_ticks = 0;
+
+void rma_setup(SudokuCtx *ctx){
+    MPI_Aint size = (SLOT_DISP(RMA_SLOTS)) * sizeof(int);
+
+    MPI_Win_allocate(size, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &rma_base, &rma_win);
+    memset(rma_base, 0, size);
+    MPI_Win_lock_all(0, rma_win);
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+void rma_teardown(void){
+    MPI_Win_unlock_all(rma_win);
+    MPI_Win_free(&rma_win);
+}
+
+//called by a busy process between two node expansions: every RMA_POLL expansions check for the end
+//of the search and publish jobs from the bottom of the work list in the free slots
+int rma_serve_requests(SudokuCtx *ctx){
+    int s;
+
+    //alone, there is nobody to publish jobs for
+    if(p == 1 || ++rma_ticks < RMA_POLL)
+        return 0;
+    rma_ticks = 0;
+
+    if(rma_fetch(rank, RMA_DONE))
+        return 1;
+
+    for(s = 0; s < RMA_SLOTS && ctx->work->len > 1; s++){
+        if(rma_fetch(rank, SLOT_DISP(s)) != SLOT_FREE)
+            continue;
+        pack_work(rma_base + SLOT_DISP(s) + 1, give_work(ctx), ctx);
+        MPI_Win_sync(rma_win);
+        rma_replace(rank, SLOT_DISP(s), SLOT_FULL);
+    }
+
+    return 0;
+}
+
+//called with an empty work list, returns 1 when new work was inserted in the list and 0 when the search is over
+int rma_steal_work(SudokuCtx *ctx){
+    int i, s, victim;
+    int *job = (int*) malloc((ctx->v_size + 2) * sizeof(int));
+
+    //jobs still published by this process are taken back first, a process owning jobs is never idle
+    if(rma_reclaim(ctx)){
+        free(job);
+        return 1;
+    }
+
+    if(rma_idle_add(1)){
+        free(job);
+        return 0;
+    }
+
+    while(!rma_fetch(rank, RMA_DONE)){
+        for(i = 1; i < p; i++){
+            victim = (rank + i) % p;
+
+            for(s = 0; s < RMA_SLOTS; s++){
+                count_send(victim, 1);
+                if(rma_fetch(victim, SLOT_DISP(s)) != SLOT_FULL)
+                    continue;
+
+                //stop being idle before the claim so that the job is always owned by a busy process
+                rma_idle_add(-1);
+                stats.steal_requests++;
+                count_send(victim, 1);
+
+                if(rma_cas(victim, SLOT_DISP(s), SLOT_FULL, SLOT_CLAIMED) != SLOT_FULL){
+                    if(rma_idle_add(1)){
+                        free(job);
+                        return 0;
+                    }
+                    continue;
+                }
+
+                //copy the job and give the slot back to its owner
+                MPI_Get(job, ctx->v_size + 2, MPI_INT, victim, SLOT_DISP(s) + 1, ctx->v_size + 2, MPI_INT, rma_win);
+                MPI_Win_flush(victim, rma_win);
+                rma_replace(victim, SLOT_DISP(s), SLOT_FREE);
+                count_send(victim, ctx->v_size + 3);
+
+                adopt_work(job, ctx);
+                if(node_of[victim] == node_of[rank])
+                    stats.steals_local++;
+                else
+                    stats.steals_remote++;
+                free(job);
+                return 1;
+            }
+        }
+    }
+
+    free(job);
+    return 0;
+}
+
+//take back one of the jobs published by this process
+int rma_reclaim(SudokuCtx *ctx){
+    int s;
+
+    for(s = 0; s < RMA_SLOTS; s++)
+        if(rma_cas(rank, SLOT_DISP(s), SLOT_FULL, SLOT_CLAIMED) == SLOT_FULL){
+            adopt_work(rma_base + SLOT_DISP(s) + 1, ctx);
+            rma_replace(rank, SLOT_DISP(s), SLOT_FREE);
+            return 1;
+        }
+
+    return 0;
+}
+
+//a process found the solution or every process is idle: mark the search as over in every window
+void rma_announce_done(void){
+    int i, done = 1;
+
+    for(i = 0; i < p; i++){
+        MPI_Accumulate(&done, 1, MPI_INT, i, RMA_DONE, 1, MPI_INT, MPI_REPLACE, rma_win);
+        count_send(i, 1);
+    }
+    MPI_Win_flush_all(rma_win);
+}
+
+//update the number of idle processes, returns 1 when this update made every process idle (no solution)
+int rma_idle_add(int value){
+    int idle;
+
+    MPI_Fetch_and_op(&value, &idle, MPI_INT, 0, RMA_IDLE, MPI_SUM, rma_win);
+    MPI_Win_flush(0, rma_win);
+    count_send(0, 1);
+
+    if(value > 0 && idle + value == p){
+        rma_announce_done();
+        return 1;
+    }
+    return 0;
+}
+
+int rma_fetch(int target, int disp){
+    int value;
+
+    MPI_Fetch_and_op(NULL, &value, MPI_INT, target, disp, MPI_NO_OP, rma_win);
+    MPI_Win_flush(target, rma_win);
+    return value;
+}
+
+int rma_cas(int target, int disp, int compare, int value){
+    int old;
+
+    MPI_Compare_and_swap(&value, &compare, &old, MPI_INT, target, disp, rma_win);
+    MPI_Win_flush(target, rma_win);
+    return old;
+}
+
+void rma_replace(int target, int disp, int value){
+    int old;
+
+    MPI_Fetch_and_op(&value, &old, MPI_INT, target, disp, MPI_REPLACE, rma_win);
+    MPI_Win_flush(target, rma_win);
+}
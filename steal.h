@@ -0,0 +1,62 @@
+#include "sudoku.h"
+
+//sudoku-sim runs every rank as a thread over an in-process MPI layer
+#ifdef MPI_SIM
+#include "mpi-sim.h"
+#else
+#include <mpi.h>
+#define SIM_LOCAL
+#endif
+
+#define TAG_HYP     1
+#define TAG_EXIT    2
+#define TAG_ASK_JOB 3
+#define TAG_NOGOOD  4 //batch of refuted boards, sent on a communicator of their own (nogood.c)
+
+//work stealing protocols selectable on the command line
+#define STEAL_TWO_SIDED 0
+#define STEAL_NODE      1
+#define STEAL_RMA       2
+
+//per rank counters of the load balancing traffic
+typedef struct{
+    long steal_requests;    //work requests sent
+    long remote_msgs;       //messages sent to ranks on another node
+    long remote_bytes;      //payload of those messages
+    long steals_local;      //work received from a rank on the same node
+    long steals_remote;     //work received from a rank on another node
+    long jobs_given;        //work sent to a rank asking for it
+}StealStats;
+
+extern SIM_LOCAL int rank, p;
+extern SIM_LOCAL int steal_mode;
+extern SIM_LOCAL StealStats stats;
+
+//node topology: communicator of the ranks sharing memory with this one, and node id of every rank
+extern SIM_LOCAL MPI_Comm node_comm;
+extern SIM_LOCAL int node_rank, node_size;
+extern SIM_LOCAL int *node_of;
+
+//helpers of sudoku-mpi.c shared by the protocols
+void send_ring(void *msg, int tag, int dest);
+void count_send(int dest, int nr_ints);
+Item give_work(SudokuCtx *ctx);
+void announce_solution(SudokuCtx *ctx);
+void pack_work(int *msg, Item hyp, SudokuCtx *ctx);
+void adopt_work(int *msg, SudokuCtx *ctx);
+int serve_messages(SudokuCtx *ctx);
+
+//hierarchical node-aware stealing over shared-memory windows (steal-node.c)
+void node_setup(SudokuCtx *ctx);
+void node_teardown(void);
+int node_serve_requests(SudokuCtx *ctx);
+int node_steal_work(SudokuCtx *ctx);
+void node_reply_no_work(int dest);
+void node_count_donation(void);
+
+//one-sided stealing over an MPI RMA window (steal-rma.c)
+void rma_setup(SudokuCtx *ctx);
+void rma_teardown(void);
+int rma_serve_requests(SudokuCtx *ctx);
+int rma_steal_work(SudokuCtx *ctx);
+void rma_announce_done(void);
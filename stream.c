@@ -0,0 +1,394 @@
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include "stream.h"
+
+#define READ_BUF (1 << 16)
+#define MAX_TOKEN 1024
+
+//input reader with its own buffer so the parser never goes through stdio per character
+typedef struct{
+    FILE *fp;
+    char buf[READ_BUF];
+    size_t len, pos;
+}Reader;
+
+typedef struct{
+    int r_size, m_size, v_size;
+    Reader *rd;
+    JobQueue *free_jobs, *in, *out;
+    int ordered, window;
+    int lanes;              //puzzles per solver thread of the lane kernel, 0 for the scalar solver
+    int active_solvers;
+    long nr_puzzles, nr_solved;
+    int invalid;            //the reader stopped at a puzzle with a number out of range
+    pthread_mutex_t lock;
+}Pipeline;
+
+void queue_init(JobQueue *q, int cap);
+void queue_destroy(JobQueue *q);
+void queue_close(JobQueue *q);
+int next_token(Reader *rd, char *tok);
+int read_puzzle(Pipeline *pl, int *sudoku);
+int token_number(const char *tok);
+void* reader_stage(void *arg);
+void* solver_stage(void *arg);
+void* writer_stage(void *arg);
+size_t format_solution(Pipeline *pl, Job *job, char *line);
+double now_seconds(void);
+
+int stream_main(int argc, char *argv[]){
+    int opt, i, nr_threads = (int) sysconf(_SC_NPROCESSORS_ONLN), queue_cap = 64, ordered = 0, lanes = 0;
+    char tok[MAX_TOKEN];
+    Pipeline pl;
+    JobQueue free_jobs, in, out;
+    pthread_t reader, writer, *solvers;
+
+    while((opt = getopt(argc, argv, "t:q:ol:")) != -1){
+        switch(opt){
+            case 't': nr_threads = atoi(optarg); break;
+            case 'q': queue_cap = atoi(optarg); break;
+            case 'o': ordered = 1; break;
+            case 'l': lanes = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: sudoku-serial --stream [-t threads] [-q queue] [-o] [-l lanes] [file]\n");
+                return 1;
+        }
+    }
+    if(nr_threads < 1) nr_threads = 1;
+    if(queue_cap < 1) queue_cap = 1;
+    if(lanes < 0) lanes = 0;
+    if(lanes > 32) lanes = 32;
+
+    Reader *rd = (Reader*) malloc(sizeof(Reader));
+    rd->len = rd->pos = 0;
+    if(optind < argc && strcmp(argv[optind], "-")){
+        if((rd->fp = fopen(argv[optind], "r")) == NULL){
+            fprintf(stderr, "unable to open file %s\n", argv[optind]);
+            exit(1);
+        }
+    }else
+        rd->fp = stdin;
+
+    //the stream starts with the same header as a single puzzle file: the box size
+    if(!next_token(rd, tok)){
+        fprintf(stderr, "empty input\n");
+        exit(1);
+    }
+    pl.r_size = token_number(tok);
+    if(pl.r_size < 1 || pl.r_size > 8){
+        fprintf(stderr, "invalid box size %s (1 to 8)\n", tok);
+        exit(1);
+    }
+    pl.m_size = pl.r_size * pl.r_size;
+    pl.v_size = pl.m_size * pl.m_size;
+
+    //the lanes keep a number per byte and the masks of a unit in 32 bits
+    if(lanes && pl.m_size > 32){
+        fprintf(stderr, "stream: no lane kernel above 32x32, using the scalar solver\n");
+        lanes = 0;
+    }
+
+    //every job buffer comes from a fixed pool, so the number of puzzles in flight
+    //(queued, being solved or waiting to be written in order) never exceeds the pool size
+    pl.window = 2 * queue_cap + nr_threads * (lanes ? lanes : 1);
+    Job *jobs = (Job*) malloc(pl.window * sizeof(Job));
+    queue_init(&free_jobs, pl.window);
+    queue_init(&in, queue_cap);
+    queue_init(&out, queue_cap);
+    for(i = 0; i < pl.window; i++){
+        jobs[i].sudoku = (int*) malloc(pl.v_size * sizeof(int));
+        queue_push(&free_jobs, &jobs[i]);
+    }
+
+    pl.rd = rd;
+    pl.free_jobs = &free_jobs;
+    pl.in = &in;
+    pl.out = &out;
+    pl.ordered = ordered;
+    pl.lanes = lanes;
+    pl.active_solvers = nr_threads;
+    pl.nr_puzzles = pl.nr_solved = 0;
+    pl.invalid = 0;
+    pthread_mutex_init(&pl.lock, NULL);
+
+    double begin = now_seconds();
+
+    solvers = (pthread_t*) malloc(nr_threads * sizeof(pthread_t));
+    pthread_create(&reader, NULL, reader_stage, &pl);
+    for(i = 0; i < nr_threads; i++)
+        pthread_create(&solvers[i], NULL, solver_stage, &pl);
+    pthread_create(&writer, NULL, writer_stage, &pl);
+
+    pthread_join(reader, NULL);
+    for(i = 0; i < nr_threads; i++)
+        pthread_join(solvers[i], NULL);
+    pthread_join(writer, NULL);
+
+    double elapsed = now_seconds() - begin;
+    fprintf(stderr, "stream: %ld puzzles, %ld solved, %d solver threads, %s kernel, %f s, %.1f puzzles/sec\n",
+            pl.nr_puzzles, pl.nr_solved, nr_threads, lanes ? "lane" : "scalar", elapsed, elapsed > 0 ? pl.nr_puzzles / elapsed : 0.0);
+
+    if(rd->fp != stdin)
+        fclose(rd->fp);
+    for(i = 0; i < pl.window; i++)
+        free(jobs[i].sudoku);
+    free(jobs);
+    free(solvers);
+    free(rd);
+    queue_destroy(&free_jobs);
+    queue_destroy(&in);
+    queue_destroy(&out);
+    pthread_mutex_destroy(&pl.lock);
+
+    return pl.invalid;
+}
+
+//reader stage: parse puzzles into pooled jobs and hand them to the solvers
+void* reader_stage(void *arg){
+    Pipeline *pl = (Pipeline*) arg;
+    long seq = 0;
+    int status;
+    Job *job;
+
+    while((job = queue_pop(pl->free_jobs)) != NULL){
+        if((status = read_puzzle(pl, job->sudoku)) <= 0){
+            if(status < 0){
+                fprintf(stderr, "puzzle %ld: number out of range 0..%d, rest of the input ignored\n", seq + 1, pl->m_size);
+                pl->invalid = 1;
+            }
+            break;
+        }
+        job->seq = seq++;
+        queue_push(pl->in, job);
+    }
+    pl->nr_puzzles = seq;
+    queue_close(pl->in);
+
+    return NULL;
+}
+
+//solver stage: the last solver to run out of input closes the output queue
+void* solver_stage(void *arg){
+    Pipeline *pl = (Pipeline*) arg;
+    Job *job;
+    SudokuCtx *ctx;
+
+    if(pl->lanes)
+        lanes_solve(pl->in, pl->out, pl->lanes, pl->r_size);
+    else{
+        //every solver thread has its own context, reused for all its puzzles
+        ctx = sudoku_new();
+        while((job = queue_pop(pl->in)) != NULL){
+            job->solved = sudoku_solve(ctx, pl->r_size, job->sudoku) == 1;
+            queue_push(pl->out, job);
+        }
+        sudoku_free(ctx);
+    }
+
+    pthread_mutex_lock(&pl->lock);
+    if(--pl->active_solvers == 0)
+        queue_close(pl->out);
+    pthread_mutex_unlock(&pl->lock);
+
+    return NULL;
+}
+
+//writer stage: one line per puzzle, either as solved or in input order
+void* writer_stage(void *arg){
+    Pipeline *pl = (Pipeline*) arg;
+    long next_seq = 0;
+    //room for a solution line (up to 3 characters per cell and the newline) or for "No solution\n"
+    char *line = (char*) malloc(pl->v_size * 3 + sizeof("No solution\n"));
+    Job *job, **pending = NULL;
+
+    //jobs finishing ahead of next_seq wait in a reorder window indexed by seq,
+    //no two jobs in flight can share a slot since the window is the pool size
+    if(pl->ordered)
+        pending = (Job**) calloc(pl->window, sizeof(Job*));
+
+    while((job = queue_pop(pl->out)) != NULL){
+        if(job->solved)
+            pl->nr_solved++;
+
+        if(!pl->ordered){
+            fwrite(line, 1, format_solution(pl, job, line), stdout);
+            queue_push(pl->free_jobs, job);
+            continue;
+        }
+
+        pending[job->seq % pl->window] = job;
+        while((job = pending[next_seq % pl->window]) != NULL && job->seq == next_seq){
+            pending[next_seq % pl->window] = NULL;
+            fwrite(line, 1, format_solution(pl, job, line), stdout);
+            queue_push(pl->free_jobs, job);
+            next_seq++;
+        }
+    }
+    fflush(stdout);
+
+    free(pending);
+    free(line);
+    return NULL;
+}
+
+//compact one-line solution: digits back to back up to 9x9, space separated numbers above
+size_t format_solution(Pipeline *pl, Job *job, char *line){
+    int i, num;
+    size_t n = 0;
+
+    if(!job->solved)
+        return (size_t) sprintf(line, "No solution\n");
+
+    for(i = 0; i < pl->v_size; i++){
+        num = job->sudoku[i];
+        if(pl->m_size <= 9)
+            line[n++] = '0' + num;
+        else{
+            if(i) line[n++] = ' ';
+            if(num >= 10) line[n++] = '0' + num / 10;
+            line[n++] = '0' + num % 10;
+        }
+    }
+    line[n++] = '\n';
+
+    return n;
+}
+
+//a puzzle is either v_size whitespace separated numbers (the single file format)
+//or, up to 9x9, a single token of v_size characters with '0' or '.' for empty cells.
+//returns 1 for a puzzle, 0 at the end of the input and -1 when a cell is not a number from 0 to m_size
+int read_puzzle(Pipeline *pl, int *sudoku){
+    int i, k = 0, tok_len;
+    char tok[MAX_TOKEN];
+
+    while(k < pl->v_size){
+        if(!(tok_len = next_token(pl->rd, tok)))
+            break;
+        if(k == 0 && tok_len == pl->v_size && pl->m_size <= 9){
+            for(i = 0; i < pl->v_size; i++){
+                sudoku[i] = tok[i] == '.' ? 0 : tok[i] - '0';
+                if(sudoku[i] < 0 || sudoku[i] > pl->m_size)
+                    return -1;
+            }
+            return 1;
+        }
+        sudoku[k] = token_number(tok);
+        if(sudoku[k] < 0 || sudoku[k] > pl->m_size)
+            return -1;
+        k++;
+    }
+
+    if(k && k < pl->v_size)
+        fprintf(stderr, "truncated puzzle at end of input ignored\n");
+    return k == pl->v_size;
+}
+
+//value of a token made of digits only, -1 for anything else
+int token_number(const char *tok){
+    int num = 0;
+
+    if(!*tok)
+        return -1;
+    for(; *tok; tok++){
+        if(!isdigit((unsigned char) *tok) || num > 1000)
+            return -1;
+        num = num * 10 + *tok - '0';
+    }
+    return num;
+}
+
+int next_token(Reader *rd, char *tok){
+    int n = 0;
+    char c;
+
+    while(1){
+        if(rd->pos == rd->len){
+            rd->len = fread(rd->buf, 1, READ_BUF, rd->fp);
+            rd->pos = 0;
+            if(!rd->len)
+                break;
+        }
+        c = rd->buf[rd->pos++];
+        if(isspace((unsigned char) c)){
+            if(n) break;
+        }else if(n < MAX_TOKEN - 1)
+            tok[n++] = c;
+    }
+    tok[n] = '\0';
+
+    return n;
+}
+
+void queue_init(JobQueue *q, int cap){
+    q->slots = (Job**) malloc(cap * sizeof(Job*));
+    q->cap = cap;
+    q->head = q->count = q->closed = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+}
+
+void queue_destroy(JobQueue *q){
+    free(q->slots);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+//block while the queue is full
+void queue_push(JobQueue *q, Job *job){
+    pthread_mutex_lock(&q->lock);
+    while(q->count == q->cap)
+        pthread_cond_wait(&q->not_full, &q->lock);
+    q->slots[(q->head + q->count++) % q->cap] = job;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+//block while the queue is empty, NULL once it is empty and closed
+Job* queue_pop(JobQueue *q){
+    Job *job = NULL;
+
+    pthread_mutex_lock(&q->lock);
+    while(!q->count && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    if(q->count){
+        job = q->slots[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return job;
+}
+
+//NULL when the queue is empty, without waiting
+Job* queue_try_pop(JobQueue *q){
+    Job *job = NULL;
+
+    pthread_mutex_lock(&q->lock);
+    if(q->count){
+        job = q->slots[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return job;
+}
+
+void queue_close(JobQueue *q){
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "sudoku.h"
+
+//a puzzle travelling through the reader -> solvers -> writer pipeline
+typedef struct{
+    long seq;       //position of the puzzle in the input
+    int solved;
+    int *sudoku;
+}Job;
+
+//bounded FIFO of jobs shared between pipeline stages
+typedef struct{
+    Job **slots;
+    int cap, head, count, closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+}JobQueue;
+
+void queue_push(JobQueue *q, Job *job);
+Job* queue_pop(JobQueue *q);
+Job* queue_try_pop(JobQueue *q);
+
+//solver stage working on many puzzles at once (lanes.c)
+void lanes_solve(JobQueue *in, JobQueue *out, int width, int r_size);
+
+int stream_main(int argc, char *argv[]);
@@ -1,78 +1,146 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
 #include <stdint.h>
-#include <mpi.h>
 #include <time.h>
-#include "list.h"
+#include <unistd.h>
+#include "steal.h"
+#include "probe.h"
+#include "nogood.h"
 
-#define UNASSIGNED 0
-#define UNCHANGEABLE -1
+//in sudoku-sim every virtual rank runs this main in its own thread
+#ifdef MPI_SIM
+#define main sim_rank_main
+#endif
 
 #define POS 0
 #define VAL 1
 
-#define TAG_HYP     1
-#define TAG_EXIT    2
-#define TAG_ASK_JOB 3
-
-#define ROW(i) i/m_size
-#define COL(i) i%m_size
-#define BOX(row, col) r_size*(row/r_size)+col/r_size
-
 #define BLOCK_LOW(rank, p, n) ((rank)*(n)/(p))
 #define BLOCK_HIGH(rank, p, n) (BLOCK_LOW(rank+1,p,n)-1)
 
-void init_masks(int* sudoku, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask);
-void update_masks(int num, int row, int col, uint64_t *rows_mask, uint64_t *cols_mask, uint64_t *boxes_mask);
-void rm_num_masks(int num, int row, int col, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask);
-int solving_sudoku(int* sudoku, int* cp_sudoku, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask, List* work, int last_pos);
-int is_safe_num( uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask, int row, int col, int num);
-int exists_in( int index, uint64_t* mask, int num);
-void delete_from(int* sudoku, int *cp_sudoku, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask, int cell);
-
-void send_ring(void *msg, int tag, int dest);
-int* read_matrix(char *argv[]);
-void print_sudoku(int *sudoku);
-int new_mask( int size);
-int solve(int *sudoku);
-Item invalid_hyp(void);
-
-int r_size, m_size, v_size, rank, p;
+int serve_requests(SudokuCtx *ctx);
+int steal_work(SudokuCtx *ctx);
+int ask_for_work(SudokuCtx *ctx);
+void reply_no_work(int dest, int idle);
+int two_sided_finished(int all_idle, long sent, long recv);
+void steal_setup(int ranks_per_node);
+void steal_teardown(void);
+int solve(SudokuCtx *ctx, int r_size, int *sudoku, long nogood);
+void print_solution(int r_size, int *sudoku);
+
+SIM_LOCAL int rank, p;
+SIM_LOCAL int steal_mode = STEAL_TWO_SIDED;
+SIM_LOCAL StealStats stats;
+SIM_LOCAL MPI_Comm node_comm;
+SIM_LOCAL int node_rank, node_size;
+SIM_LOCAL int *node_of;
+
+//state of the termination detection of the two-sided protocol, run by rank 0
+SIM_LOCAL int two_sided_valid = 0;
+SIM_LOCAL long two_sided_sent, two_sided_recv;
 
 int main(int argc, char *argv[]){
       clock_t begin = clock();
 
-    int* sudoku, result, total;
+    int* sudoku, r_size, result, total, first, ranks_per_node = 0;
+    long nogood = NOGOOD_ENTRIES;
+    int verdict[2];
+    double wall_time;
+    SudokuCtx *ctx;
+    ProbeLimits limits;
+    Probe probe;
+    char *rest;
+
+    //difficulty probe thresholds and size of the nogood cache, given as options in front of the input file
+    probe_defaults(&limits);
+    for(first = 1; first < argc && !strncmp(argv[first], "--", 2); first += 2){
+        if(first + 1 < argc && !strcmp(argv[first], "--nogood")){
+            nogood = strtol(argv[first + 1], &rest, 10);
+            if(rest == argv[first + 1] || *rest){
+                first = -1;
+                break;
+            }
+        }
+        else if(first + 1 == argc || !probe_option(argv[first], argv[first + 1], &limits)){
+            first = -1;
+            break;
+        }
+    }
+    if(first > 0 && !probe_check(&limits))
+        first = -1;
+
+    if(first > 0 && argc - first >= 1 && argc - first <= 3){
+        //optional work stealing protocol and, to emulate several nodes on one host, ranks per node
+        if(argc - first >= 2){
+            if(!strcmp(argv[first + 1], "node"))
+                steal_mode = STEAL_NODE;
+            else if(!strcmp(argv[first + 1], "rma"))
+                steal_mode = STEAL_RMA;
+            else if(strcmp(argv[first + 1], "two-sided")){
+                printf("unknown work stealing protocol %s (two-sided | node | rma)\n", argv[first + 1]);
+                return 1;
+            }
+        }
+        if(argc - first == 3)
+            ranks_per_node = atoi(argv[first + 2]);
 
-    if(argc == 2){
-        sudoku = read_matrix(argv);
+        if((sudoku = sudoku_read(argv[first], &r_size)) == NULL)
+            return 1;
+        ctx = sudoku_new();
 
         MPI_Init (&argc, &argv);
         MPI_Comm_rank (MPI_COMM_WORLD, &rank);
         MPI_Comm_size (MPI_COMM_WORLD, &p);
 
-        result = solve(sudoku);
+        steal_setup(ranks_per_node);
 
-        MPI_Barrier(MPI_COMM_WORLD);
-        MPI_Allreduce(&result, &total, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        wall_time = MPI_Wtime();
+
+        //rank 0 tries to finish the puzzle alone, the others only wait for its verdict
+        if(!rank){
+            probe_sudoku(ctx, r_size, sudoku, &limits, &probe);
+            probe_log(&limits, &probe);
+#ifdef MPI_SIM
+            sim_work(probe.nodes);
+#endif
+            verdict[0] = probe.local;
+            verdict[1] = probe.result;
+        }
+        MPI_Bcast(verdict, 2, MPI_INT, 0, MPI_COMM_WORLD);
+
+        if(verdict[0]){
+            result = !rank && verdict[1] == 1;
+            total = verdict[1] == 1;
+            wall_time = MPI_Wtime() - wall_time;
+        }else{
+            result = solve(ctx, r_size, sudoku, nogood);
+            wall_time = MPI_Wtime() - wall_time;
+
+            MPI_Barrier(MPI_COMM_WORLD);
+            MPI_Allreduce(&result, &total, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        }
 
         if(!total && !rank)
             printf("No solution\n");
-        else if(total && result){
-            printf("\n Rank = %d \n", rank);
-            printf("\n     SOLUTION: \n\n");
-            print_sudoku(sudoku);
-        }
+        else if(total && result)
+            print_solution(r_size, sudoku);
+
+        printf("\n ****Rank = %d --- steal requests %ld, cross-node messages %ld (%ld bytes), steals %ld local / %ld remote, wall time %f s\n",
+               rank, stats.steal_requests, stats.remote_msgs, stats.remote_bytes, stats.steals_local, stats.steals_remote, wall_time);
 
+        steal_teardown();
         fflush(stdout);
         MPI_Finalize();
 
     }
-    else
+    else{
         printf("invalid input arguments.\n");
+        printf("usage: sudoku-mpi [--budget nodes] [--min-clues fraction] [--max-density fraction] [--nogood entries] <file> [two-sided|node|rma [ranks_per_node]]\n");
+        return 1;
+    }
 
+    sudoku_free(ctx);
     free(sudoku);
 
         clock_t end = clock();
@@ -82,202 +150,183 @@ int main(int argc, char *argv[]){
     return 0;
 }
 
-int solve(int* sudoku){
-    int i, last_pos, flag_start = 0, solved = 0;
+//the solution goes out in a single write, atomic on the pipe to mpirun up to PIPE_BUF bytes (every grid
+//up to 25x25): the lines printed by the other processes meanwhile can not end up between two of its rows
+void print_solution(int r_size, int *sudoku){
+    char *text;
+    size_t len;
+    FILE *out = open_memstream(&text, &len);
+
+    fprintf(out, "\n Rank = %d \n", rank);
+    fprintf(out, "\n     SOLUTION: \n\n");
+    sudoku_fprint(out, r_size, sudoku);
+    fclose(out);
+
+    fflush(stdout);
+    if(write(STDOUT_FILENO, text, len) < 0)
+        perror("write");
+    free(text);
+}
+
+//the search of the library, with the work list shared with the other processes through the hooks
+int solve(SudokuCtx *ctx, int r_size, int* sudoku, long nogood){
+    int i, solved;
     Item hyp;
+    SudokuHooks hooks = {serve_requests, steal_work, announce_solution, nogood_prune};
 
-    uint64_t *rows_mask = (uint64_t*) malloc(m_size * sizeof(uint64_t));
-    uint64_t *cols_mask = (uint64_t*) malloc(m_size * sizeof(uint64_t));
-    uint64_t *boxes_mask = (uint64_t*) malloc(m_size * sizeof(uint64_t));
-    int *cp_sudoku = (int*) malloc(v_size * sizeof(int));
-    //A work list contains the pairs (cell_id, number) from which serial DFS search must still be performed
-    //(in other words it contains the root values of the unexplored parts of the search tree)
-    List *work = init_list();
-
-    for(i = 0; i < v_size; i++) {
-        if(sudoku[i])
-            cp_sudoku[i] = UNCHANGEABLE;
-        else{
-            cp_sudoku[i] = UNASSIGNED;
-            if(!flag_start){
-                flag_start = 1;
-                hyp.cell = i;
-            }
-            last_pos = i;
-        }
-    }
+    //alone, there is nobody to get work from
+    if(p == 1)
+        hooks.refill = NULL;
+    if(nogood <= 0)
+        hooks.prune = NULL;
+
+    sudoku_start(ctx, r_size, sudoku);
 
-    init_masks(sudoku, rows_mask, cols_mask, boxes_mask);
+    //clues in conflict or nothing left to fill in, every process sees it
+    if(sudoku_conflict(ctx))
+        return 0;
+    if(ctx->first_pos < 0)
+        return !rank;
 
     //calculate the low and high values for the first cell for each process
     //and insert it in the work list
     //Assign a different set of numbers to each process to find their possible locations i.e. different work lists.
-    for(i = 1 + BLOCK_HIGH(rank, p, m_size); i >= 1 + BLOCK_LOW(rank, p, m_size); i--){
+    hyp.cell = ctx->first_pos;
+    for(i = 1 + BLOCK_HIGH(rank, p, ctx->m_size); i >= 1 + BLOCK_LOW(rank, p, ctx->m_size); i--){
         hyp.num = i;
-        insert_head(work, hyp);
+        insert_head(ctx->work, hyp);
     }
 
+    if(steal_mode == STEAL_NODE)
+        node_setup(ctx);
+    else if(steal_mode == STEAL_RMA)
+        rma_setup(ctx);
+    nogood_setup(ctx, nogood);
+
     // try to solve sudoku
-    solved = solving_sudoku(sudoku, cp_sudoku, rows_mask, cols_mask, boxes_mask, work, last_pos);
+    ctx->hooks = &hooks;
+    solved = sudoku_search(ctx) == 1;
+    ctx->hooks = NULL;
 
-    if(solved){
-        //if the solution is found copy the solution to be retrieved
-        for(i = 0; i < v_size; i++)
-            if(cp_sudoku[i] != UNCHANGEABLE)
-                sudoku[i] = cp_sudoku[i];
-    }
+    //if the solution is found copy the solution to be retrieved
+    if(solved)
+        sudoku_result(ctx, sudoku);
+
+    nogood_teardown(ctx);
+    if(steal_mode == STEAL_NODE)
+        node_teardown();
+    else if(steal_mode == STEAL_RMA)
+        rma_teardown();
 
-    free(work);
-    free(rows_mask);
-    free(cols_mask);
-    free(boxes_mask);
-    free(cp_sudoku);
+    clear_list(ctx->work);
 
     return solved;
 }
 
-int solving_sudoku(int* sudoku, int* cp_sudoku, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask, List* work, int last_pos){
-    int i, cell, val, number_amount, flag = 0, no_sol_count, len;
+//called between two node expansions, returns 1 if an exit signal was received
+int serve_requests(SudokuCtx *ctx){
+#ifdef MPI_SIM
+    //the simulated time of the expansion itself, the MPI calls of the protocols are charged apart
+    sim_work(1);
+#endif
+    if(steal_mode == STEAL_NODE)
+        return node_serve_requests(ctx);
+    if(steal_mode == STEAL_RMA)
+        return rma_serve_requests(ctx);
+    return serve_messages(ctx);
+}
+
+//called with an empty work list, returns 1 when new work was inserted in the list and 0 when the search is over
+int steal_work(SudokuCtx *ctx){
+    nogood_exhausted(ctx);
+    if(steal_mode == STEAL_NODE)
+        return node_steal_work(ctx);
+    if(steal_mode == STEAL_RMA)
+        return rma_steal_work(ctx);
+    return ask_for_work(ctx);
+}
 
-    MPI_Request request;
+//listen to incoming messages: give away the bottom of the work list to processes asking for a job
+int serve_messages(SudokuCtx *ctx){
+    int flag = 0, number_amount;
     MPI_Status status;
-    Item hyp, no_hyp = invalid_hyp();
 
-    //a while loop to get work from other processes when the list gets empty
-    while(1){
+    MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
 
-        //a while loop to get work from the work list
-        while(work->head != NULL){
+    //if a message has been received
+    if(flag && status.MPI_TAG != -1){
 
-            //pop a probable number from the work list
-            hyp = pop_head(work);
-            len = work->len;
-            int start_pos = hyp.cell;
+        //find the size of the message and allocate a buffer for the message
+        MPI_Get_count(&status, MPI_INT, &number_amount);
+        int* number_buf = (int*)malloc(number_amount * sizeof(int));
 
-            //if the number of the initial hypothesis is not valid skip this hypothesis
-            //check if it is safe to add number in hyp.cell i.e hyp.num already exists in row/col/box
-            if(!is_safe_num(rows_mask, cols_mask, boxes_mask, ROW(hyp.cell), COL(hyp.cell), hyp.num))
-                continue;
+        //read the message to the allocated buffer
+        MPI_Recv(number_buf, number_amount, MPI_INT, status.MPI_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
 
-            //a while loop to solve the sudoku
-            while(1){
-
-                //listen to incoming messages
-                MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
-
-                //if a message has been received
-                if(flag && status.MPI_TAG != -1){
-                    flag = 0;
-
-                    //find the size of the message and allocate a buffer for the message
-                    MPI_Get_count(&status, MPI_INT, &number_amount);
-                    int* number_buf = (int*)malloc(number_amount * sizeof(int));
-
-                    //read the message to the allocated buffer
-                    MPI_Recv(number_buf, number_amount, MPI_INT, status.MPI_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-
-                    //if the message is an exit signal, forward the message in the ring and return
-                    if(status.MPI_TAG == TAG_EXIT){  //TAG_EXIT = 2
-                        send_ring(&rank, TAG_EXIT, -1);
-                        return 0;
-                    }
-                                        //if the message is a job request
-                    else if(status.MPI_TAG == TAG_ASK_JOB){ //TAG_ASK_JOB = 3
-
-                        //and if there is work to give in the list
-                        if(work->tail != NULL){
-
-                            //remove an hypothesis from the list
-                            Item hyp_send = pop_tail(work);
-
-                            //concatenate the hypothesis with the sudoku and send it
-                            int* send_msg = (int*)malloc((v_size+2)*sizeof(int));
-                            memcpy(send_msg, &hyp_send, sizeof(Item));
-                            memcpy((send_msg+2), cp_sudoku, v_size*sizeof(int));
-
-                            //send the message
-                            MPI_Send(send_msg, (v_size+2), MPI_INT, status.MPI_SOURCE, TAG_HYP, MPI_COMM_WORLD);
-                            free(send_msg);
-                        }
-                        else //if there isn't work to do send an impossible hypothesis message
-                            MPI_Send(&no_hyp, 2, MPI_INT, status.MPI_SOURCE, TAG_HYP, MPI_COMM_WORLD);
-                    }
-                    free(number_buf);
-                }
-
-                //update the masks and sudoku with the hypothesis removed from the list
-                update_masks(hyp.num, ROW(hyp.cell), COL(hyp.cell), rows_mask, cols_mask, boxes_mask);
-                cp_sudoku[hyp.cell] = hyp.num;
-
-                //iterate cells of the sudoku
-                for(cell = hyp.cell + 1; cell < v_size; cell++){
-
-                    //find a subsequent cell which does not have a value yet
-                    if(cp_sudoku[cell]) //if the cell has an unchangeable number skip the cell
-                        continue;
-
-                    //test numbers in the cell////find all possibles value which can go in that cell
-                    for(val = m_size; val >= 1; val--){
-
-                        //if the current number is not valid in this cell skip the number
-                        if(is_safe_num(rows_mask, cols_mask, boxes_mask, ROW(cell), COL(cell), val)){
-
-                            //if the cell is the last one and a valid number for it was found the sudoku has been solved
-                            //send an exit signal message to the ring of communication and return
-                            if(cell == last_pos){
-                                cp_sudoku[cell] = val;
-                                send_ring(&rank, TAG_EXIT, -1);
-                                return 1;
-                            }
-
-                            //insert the safe number for the cell as an hypothesis in the work list
-                            hyp.cell = cell;
-                            hyp.num = val;
-                            insert_head(work, hyp);
-                        }
-
-                    }
-
-                    break;
-                }
-
-                if(work->len == len){
-                    for(cell = v_size - 1; cell >= start_pos; cell--)
-                        if(cp_sudoku[cell] > 0){
-                            rm_num_masks(cp_sudoku[cell],  ROW(cell), COL(cell), rows_mask, cols_mask, boxes_mask);
-                            cp_sudoku[cell] = UNASSIGNED;
-                        }
-                    break;
-                }
-
-                //take a new hypothesis from the work list
-                hyp = pop_head(work);
-
-                //clear the sudoku down to the point of that hypothesis
-                for(cell--; cell >= hyp.cell; cell--){
-                    if(cp_sudoku[cell] > 0) {
-                        rm_num_masks(cp_sudoku[cell],  ROW(cell), COL(cell), rows_mask, cols_mask, boxes_mask);
-                        cp_sudoku[cell] = UNASSIGNED;
-                    }
-                }
+        //if the message is an exit signal, forward the message in the ring and return
+        if(status.MPI_TAG == TAG_EXIT){  //TAG_EXIT = 2
+            free(number_buf);
+            send_ring(&rank, TAG_EXIT, -1);
+            return 1;
+        }
+        //if the message is a job request
+        else if(status.MPI_TAG == TAG_ASK_JOB){ //TAG_ASK_JOB = 3
+
+            //and if there is work to give in the list
+            if(ctx->work->tail != NULL){
+
+                //remove an hypothesis from the list
+                Item hyp_send = give_work(ctx);
+
+                //concatenate the hypothesis with the sudoku and send it
+                int* send_msg = (int*)malloc((ctx->v_size+2)*sizeof(int));
+                pack_work(send_msg, hyp_send, ctx);
+
+                //send the message
+                MPI_Send(send_msg, (ctx->v_size+2), MPI_INT, status.MPI_SOURCE, TAG_HYP, MPI_COMM_WORLD);
+                count_send(status.MPI_SOURCE, ctx->v_size+2);
+                stats.jobs_given++;
+                if(steal_mode == STEAL_NODE)
+                    node_count_donation();
+                free(send_msg);
             }
+            else //if there isn't work to do send an impossible hypothesis message, this process is still searching
+                reply_no_work(status.MPI_SOURCE, 0);
         }
+        free(number_buf);
+    }
+
+    return 0;
+}
 
-        no_sol_count = 0;
+//cycle to ask other processes for work, one request at a time
+int ask_for_work(SudokuCtx *ctx){
+    int i, number_amount, all_idle = 1;
+    long sent = 0, recv = 0;
+    MPI_Status status;
 
-        if(p == 1)
-            return 0;
+    for(i = rank + 1;; i++){
 
-        //cycle to ask other processes for work
-        for(i = rank + 1;; i++){
+        if(i == p) i = 0;
 
-            if(i == p) i = 0;
-            if(i == rank) continue;
+        //rank 0 went through all the other processes: check whether they are all out of work
+        if(i == rank){
+            if(rank == 0 && two_sided_finished(all_idle, sent, recv)){
+                send_ring(&rank, TAG_EXIT, -1);
+                return 0;
+            }
+            all_idle = 1;
+            sent = recv = 0;
+            continue;
+        }
 
-            //send a work request message to the ith process
-            MPI_Send(&i, 1, MPI_INT, i, TAG_ASK_JOB, MPI_COMM_WORLD);
+        //send a work request message to the ith process
+        MPI_Send(&i, 1, MPI_INT, i, TAG_ASK_JOB, MPI_COMM_WORLD);
+        count_send(i, 1);
+        stats.steal_requests++;
 
-            //wait for an incoming message from any process
+        //wait for the answer of the ith process, refusing the requests of the others meanwhile
+        while(1){
             MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
 
             //find the size of the received message and allocate a buffer for the message
@@ -287,196 +336,150 @@ int solving_sudoku(int* sudoku, int* cp_sudoku, uint64_t* rows_mask, uint64_t* c
             //read the message to the allocated buffer
             MPI_Recv(number_buf, number_amount, MPI_INT, status.MPI_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
 
-            //if the message is a new hypothesis
-            if(status.MPI_TAG == TAG_HYP && number_amount != 2){
-
-                //take the hypothesis and sudoku information from the message
-                Item hyp_recv;
-                memcpy(&hyp_recv, number_buf, sizeof(Item));
-                memcpy(cp_sudoku, (number_buf+2), v_size*sizeof(int));
-
-                //delete everything to the point of the received hypothesis
-                delete_from(sudoku, cp_sudoku, rows_mask, cols_mask, boxes_mask, hyp_recv.cell);
-
-                //insert it in the work list
-                insert_head(work, hyp_recv);
-                free(number_buf);
-
-                break;
-
-            //if the message is an invalid hypothesis increase the number of processos without work
-            }else if(status.MPI_TAG == TAG_HYP && number_amount == 2){
-                no_sol_count++;
-
             //if the message is an exit signal forward the signal to the ring and return
-            }else if(status.MPI_TAG == TAG_EXIT){
+            if(status.MPI_TAG == TAG_EXIT){
+                free(number_buf);
                 send_ring(&rank, TAG_EXIT, -1);
                 return 0;
 
             //if the message is a request for work send a no work to give message
             }else if(status.MPI_TAG == TAG_ASK_JOB){
-                MPI_Send(&no_hyp, 2, MPI_INT, status.MPI_SOURCE, TAG_HYP, MPI_COMM_WORLD);
+                reply_no_work(status.MPI_SOURCE, 1);
+                free(number_buf);
+                continue;
             }
 
-            //if all other processes had no work to give there is no solution to the sudoku
-            if(no_sol_count == p-1 && rank == 0){
-                send_ring(&rank, TAG_EXIT, -1);
-                return 0;
+            //if the message is a new hypothesis
+            if(number_amount == ctx->v_size + 2){
+
+                //take the hypothesis and sudoku information from the message and insert it in the work list
+                adopt_work(number_buf, ctx);
+                if(node_of[status.MPI_SOURCE] == node_of[rank])
+                    stats.steals_local++;
+                else
+                    stats.steals_remote++;
+                free(number_buf);
+
+                return 1;
             }
 
+            //no work: {-1, idle, jobs given, jobs received}
+            all_idle &= number_buf[1];
+            sent += number_buf[2];
+            recv += number_buf[3];
             free(number_buf);
+            break;
         }
     }
 }
 
-//when a process receives a new hypothesis and the corresponding cp_sudoku, then we has to clear all the work
-//that the sender process have done after the hypothesis's position
-void delete_from(int* sudoku, int *cp_sudoku, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask, int cell){
-    int i;
+//termination detection of the two-sided protocol (four counters): two consecutive passes of rank 0
+//finding every process idle, with as many jobs given as received and no job moved in between.
+//A refusal only tells the state of a process when it was sent, counting them is not enough
+int two_sided_finished(int all_idle, long sent, long recv){
+    int finished;
 
-    //initialize the masks from the sudoku read from the file
-    init_masks(sudoku, rows_mask, cols_mask, boxes_mask);
+    sent += stats.jobs_given;
+    recv += stats.steals_local + stats.steals_remote;
 
-    //clear all work done by the sender process
-    for(i = v_size; i >= cell; i--)
-        if(cp_sudoku[i] > 0)
-            cp_sudoku[i] = UNASSIGNED;
+    finished = all_idle && two_sided_valid && sent == recv && sent == two_sided_sent && recv == two_sided_recv;
+    two_sided_valid = all_idle;
+    two_sided_sent = sent;
+    two_sided_recv = recv;
 
-    //initialize the masks from the cp_sudoku received
-    for(i = 0; i < cell; i++)
-        if(cp_sudoku[i] > 0)
-            update_masks(cp_sudoku[i], ROW(i), COL(i), rows_mask, cols_mask, boxes_mask);
+    return finished;
 }
 
-//create an invalid hypothesis
-Item invalid_hyp(void){
-    Item item;
-    item.cell = -1;
-    item.num = -1;
-    return item;
+//remove the oldest hypothesis of the work list to give it to another process
+Item give_work(SudokuCtx *ctx){
+    ctx->nr_given++;
+    return pop_tail(ctx->work);
 }
 
-void send_ring(void *msg, int tag, int dest){
-    int msg_send[2];
-    msg_send[0] =*((int*) msg);
-    msg_send[1] = dest;
+//the sudoku has been solved: stop the other processes (solved hook of the search, the solution stays in ctx)
+void announce_solution(SudokuCtx *ctx){
+    (void) ctx;
 
-    if(rank == p-1)
-        MPI_Send(msg_send, 2, MPI_INT, 0, tag, MPI_COMM_WORLD);
+    if(steal_mode == STEAL_RMA)
+        rma_announce_done();
     else
-        MPI_Send(msg_send, 2, MPI_INT, rank + 1, tag, MPI_COMM_WORLD);
-}
-
-//test if a number (num) exists in a row, column or box. To check if it exists in a row, the mask of that row is passed as input
-int exists_in(int index, uint64_t* mask, int num) {
-    int res, masked_num = 1 << (num-1);
-
-    res = mask[index] | masked_num;  //example row_mask = 1010 ; number to check = 0100 (3) then row_masl | num = 1110
-    if(res != mask[index])           // since the result is different from the initial mask, it is safe to put 3 in this row/col/box
-        return 0;
-    return 1;
-}
-
-//check if a given number is safe in a given cell (row,col) for that check safety in corresponding row, column and box
-int is_safe_num(uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask, int row, int col, int num) {
-    return !exists_in(row, rows_mask, num) && !exists_in(col, cols_mask, num) && !exists_in(BOX(row, col), boxes_mask, num);
+        send_ring(&rank, TAG_EXIT, -1);
 }
 
-//initialize a mask
-/*int new_mask(int size) {
-    return (0 << (size-1));
-}*/
+//tell a process asking for a job that there is nothing to give, whether this one is idle and how many jobs it moved
+void reply_no_work(int dest, int idle){
+    int msg[4];
 
-
-//initialize the masks from the sudoku read from the file
-void init_masks(int* sudoku, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask) {
-    int i;
-
-    for(i = 0; i < m_size; i++){
-        rows_mask[i]  = UNASSIGNED;
-        cols_mask[i]  = UNASSIGNED;
-        boxes_mask[i] = UNASSIGNED;
+    if(steal_mode == STEAL_NODE){
+        node_reply_no_work(dest);
+        return;
     }
 
-    for(i = 0; i < v_size; i++)
-        if(sudoku[i])
-            update_masks(sudoku[i], ROW(i), COL(i), rows_mask, cols_mask, boxes_mask);
-}
+    msg[0] = -1;
+    msg[1] = idle;
+    msg[2] = stats.jobs_given;
+    msg[3] = stats.steals_local + stats.steals_remote;
 
-//remove number from the masks
-void rm_num_masks(int num, int row, int col, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask) {
-    int num_mask = 1 << (num-1);
-    rows_mask[row] ^= num_mask;
-    cols_mask[col] ^= num_mask;
-    boxes_mask[BOX(row, col)] ^= num_mask;
+    MPI_Send(msg, 4, MPI_INT, dest, TAG_HYP, MPI_COMM_WORLD);
+    count_send(dest, 4);
 }
 
-//add new number to the masks
-void update_masks(int num, int row, int col, uint64_t* rows_mask, uint64_t* cols_mask, uint64_t* boxes_mask) {
-    int new_mask = 1 << (num-1);  //convert number found to mask ex: if dim=4x4, 3 = 0010
-    rows_mask[row] |= new_mask;      //to add the new number to the current row's mask use bitwise OR
-    cols_mask[col] |= new_mask;      //ex row_mask = 0101 ; number to add: 0010 --> row_mask OR num = 0111
-    boxes_mask[BOX(row, col)] |= new_mask;
+//the message carrying a job: the hypothesis followed by the sudoku of the giving process
+void pack_work(int *msg, Item hyp, SudokuCtx *ctx){
+    memcpy(msg, &hyp, sizeof(Item));
+    memcpy((msg+2), ctx->cp_sudoku, ctx->v_size*sizeof(int));
 }
 
-//read the input file
-int* read_matrix(char *argv[]) {
-    FILE *fp;
-    size_t characters, len = 1;
-    char *line = NULL, aux[3];
-    int i, j, k, l;
+//take the hypothesis and sudoku from a job, delete everything to the point of the hypothesis and insert it in the work list
+void adopt_work(int *msg, SudokuCtx *ctx){
+    Item hyp_recv;
 
-    if((fp = fopen(argv[1], "r+")) == NULL) {
-        fprintf(stderr, "unable to open file %s\n", argv[1]);
-        exit(1);
-    }
+    memcpy(&hyp_recv, msg, sizeof(Item));
+    memcpy(ctx->cp_sudoku, (msg+2), ctx->v_size*sizeof(int));
+    sudoku_delete_from(ctx, hyp_recv.cell);
+    insert_head(ctx->work, hyp_recv);
+}
 
-    getline(&line, &len, fp);
-    r_size = atoi(line);
-    m_size = r_size *r_size;
-    v_size = m_size * m_size;
-
-    int* sudoku = (int*)malloc(v_size * sizeof(int));
-
-    k = 0, l = 0;
-    len = m_size * 2;
-    for(i = 0; (characters = getline(&line, &len, fp)) != -1; i++){
-        for (j = 0; j < characters; j++) {
-            if(isdigit(line[j])){
-                aux[l++] = line[j];
-            }else if(l > 0){
-                aux[l] = '\0';
-                l = 0;
-                sudoku[k++] = atoi(aux);
-                memset(aux, 0, sizeof aux);
-            }
-        }
+//account the messages leaving the node
+void count_send(int dest, int nr_ints){
+    if(node_of[dest] != node_of[rank]){
+        stats.remote_msgs++;
+        stats.remote_bytes += nr_ints * sizeof(int);
     }
+}
+
+//group the ranks by node, either the shared memory domains found by MPI or blocks of ranks_per_node ranks
+void steal_setup(int ranks_per_node){
+    int leader;
 
-    free(line);
-    fclose(fp);
+    if(ranks_per_node > 0)
+        MPI_Comm_split(MPI_COMM_WORLD, rank / ranks_per_node, rank, &node_comm);
+    else
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    //a node is identified by the world rank of its first process
+    leader = rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, node_comm);
+    node_of = (int*) malloc(p * sizeof(int));
+    MPI_Allgather(&leader, 1, MPI_INT, node_of, 1, MPI_INT, MPI_COMM_WORLD);
 
-    return sudoku;
+    memset(&stats, 0, sizeof(stats));
 }
 
-void print_sudoku(int *sudoku) {
-    int i;
+void steal_teardown(void){
+    free(node_of);
+    MPI_Comm_free(&node_comm);
+}
 
-    for (i = 0; i < v_size; i++) {
-        if(i%m_size != m_size - 1){
-            printf("%2d ", sudoku[i]);
-            if (i% r_size == r_size -1)
-                printf("  |  ");
-        }
-        else{
-            printf("%2d\n\n", sudoku[i]);
-            //printf("\n");
-            if (i%(m_size*r_size)==(m_size*r_size)-1){
-              for (int j = 0; j<m_size; j++)
-                  printf("----");
-              printf("\n");
-            }
+void send_ring(void *msg, int tag, int dest){
+    int msg_send[2];
+    msg_send[0] =*((int*) msg);
+    msg_send[1] = dest;
 
-        }
-    }
+    if(rank == p-1)
+        MPI_Send(msg_send, 2, MPI_INT, 0, tag, MPI_COMM_WORLD);
+    else
+        MPI_Send(msg_send, 2, MPI_INT, rank + 1, tag, MPI_COMM_WORLD);
 }
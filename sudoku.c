@@ -0,0 +1,402 @@
+#include <ctype.h>
+#include "sudoku.h"
+
+#define ROW(i) (i)/ctx->m_size
+#define COL(i) (i)%ctx->m_size
+#define BOX(row, col) ctx->r_size*((row)/ctx->r_size)+(col)/ctx->r_size
+
+SudokuCtx* sudoku_new(void){
+    SudokuCtx *ctx = (SudokuCtx*) calloc(1, sizeof(SudokuCtx));
+
+    ctx->work = init_list();
+    ctx->first_pos = ctx->last_pos = -1;
+    return ctx;
+}
+
+void sudoku_free(SudokuCtx *ctx){
+    free_list(ctx->work);
+    free(ctx->cp_sudoku);
+    free(ctx->rows_mask);
+    free(ctx->cols_mask);
+    free(ctx->boxes_mask);
+    free(ctx);
+}
+
+//set the dimensions, the buffers are only reallocated for a larger puzzle than any before
+static void sudoku_size(SudokuCtx *ctx, int r_size){
+    ctx->r_size = r_size;
+    ctx->m_size = r_size * r_size;
+    ctx->v_size = ctx->m_size * ctx->m_size;
+
+    if(ctx->m_size > ctx->cap_m_size){
+        ctx->cap_m_size = ctx->m_size;
+        ctx->cp_sudoku = (int*) realloc(ctx->cp_sudoku, ctx->v_size * sizeof(int));
+        ctx->rows_mask = (uint64_t*) realloc(ctx->rows_mask, ctx->m_size * sizeof(uint64_t));
+        ctx->cols_mask = (uint64_t*) realloc(ctx->cols_mask, ctx->m_size * sizeof(uint64_t));
+        ctx->boxes_mask = (uint64_t*) realloc(ctx->boxes_mask, ctx->m_size * sizeof(uint64_t));
+    }
+}
+
+//load a puzzle in the context: masks from the clues, empty work list
+void sudoku_start(SudokuCtx *ctx, int r_size, int *sudoku){
+    int i;
+
+    sudoku_size(ctx, r_size);
+    ctx->sudoku = sudoku;
+    ctx->first_pos = ctx->last_pos = -1;
+    ctx->nr_iterations = 0;
+    ctx->nr_given = 0;
+    clear_list(ctx->work);
+
+    for(i = 0; i < ctx->v_size; i++) {
+        if(sudoku[i])
+            ctx->cp_sudoku[i] = UNCHANGEABLE;
+        else{
+            ctx->cp_sudoku[i] = UNASSIGNED;
+            if(ctx->first_pos < 0)
+                ctx->first_pos = i;
+            ctx->last_pos = i;
+        }
+    }
+
+    sudoku_init_masks(ctx, sudoku);
+}
+
+int sudoku_solve(SudokuCtx *ctx, int r_size, int *sudoku){
+    int i, solved;
+    Item hyp;
+
+    if(!sudoku_valid(r_size, sudoku))
+        return -2;
+
+    sudoku_start(ctx, r_size, sudoku);
+
+    //the search never checks the clues against each other
+    if(sudoku_conflict(ctx))
+        return 0;
+
+    //nothing left to fill in
+    if(ctx->first_pos < 0)
+        return 1;
+
+    //insert all possible numbers of the first empty cell into the work list
+    hyp.cell = ctx->first_pos;
+    for(i = ctx->m_size; i >= 1; i--){
+        hyp.num = i;
+        insert_head(ctx->work, hyp);
+    }
+
+    solved = sudoku_search(ctx);
+    if(solved == 1)
+        sudoku_result(ctx, sudoku);
+
+    //the hypotheses left over when the search stops
+    clear_list(ctx->work);
+
+    return solved;
+}
+
+//the masks hold at most 64 numbers: 1 when r_size is from 1 to 8 and every number from 0 to r_size^2
+int sudoku_valid(int r_size, const int *sudoku){
+    int i, m_size = r_size * r_size;
+
+    if(r_size < 1 || r_size > 8)
+        return 0;
+    for(i = 0; i < m_size * m_size; i++)
+        if(sudoku[i] < 0 || sudoku[i] > m_size)
+            return 0;
+    return 1;
+}
+
+//1 when two clues are in the same row, column or box, called after sudoku_start:
+//a unit then has fewer bits set in its mask than clues in its cells
+int sudoku_conflict(SudokuCtx *ctx){
+    int i, clues = 0, rows = 0, cols = 0, boxes = 0;
+
+    for(i = 0; i < ctx->v_size; i++)
+        if(ctx->cp_sudoku[i] == UNCHANGEABLE)
+            clues++;
+    for(i = 0; i < ctx->m_size; i++){
+        rows += __builtin_popcountll(ctx->rows_mask[i]);
+        cols += __builtin_popcountll(ctx->cols_mask[i]);
+        boxes += __builtin_popcountll(ctx->boxes_mask[i]);
+    }
+    return rows < clues || cols < clues || boxes < clues;
+}
+
+//depth first search from the hypotheses of the work list: 1 when the grid is completed, 0 when the
+//work list ran out (or a hook stopped the search) and -1 when the budget ran out
+int sudoku_search(SudokuCtx *ctx){
+    int cell, val, len, outside, start_pos, pruned;
+    long given;
+    int *cp_sudoku = ctx->cp_sudoku;
+    List *work = ctx->work;
+    SudokuHooks *hooks = ctx->hooks;
+    Item hyp;
+
+    //a while loop to get work from the hooks when the list gets empty
+    while(1){
+
+        //a while loop to get work from the work list
+        while(work->head != NULL){
+
+            //pop a probable number from the work list
+            hyp = pop_head(work);
+            len = work->len;
+            given = ctx->nr_given;
+            start_pos = hyp.cell;
+
+            //check if it is safe to add number in hyp.cell i.e hyp.num already exists in row/col/box
+            if(!sudoku_is_safe_num(ctx, hyp.cell, hyp.num))
+                continue;
+
+            //a while loop to solve the sudoku
+            while(1){
+
+                //answer the other solvers, stop if they say so
+                if(hooks != NULL && hooks->poll != NULL && hooks->poll(ctx))
+                    return 0;
+                if(ctx->budget && ctx->nr_iterations == ctx->budget)
+                    return -1;
+                ctx->nr_iterations++;
+
+                //a hypothesis whose subtree is known to hold no solution is expanded without children
+                pruned = hooks != NULL && hooks->prune != NULL && hooks->prune(ctx, hyp);
+
+                //update the masks and sudoku with the hypothesis removed from the list
+                sudoku_update_masks(ctx, hyp.num, hyp.cell);
+                cp_sudoku[hyp.cell] = hyp.num;
+
+                //the hypothesis was for the last empty cell
+                if(hyp.cell == ctx->last_pos && !pruned){
+                    if(hooks != NULL && hooks->solved != NULL)
+                        hooks->solved(ctx);
+                    return 1;
+                }
+
+                //iterate cells of the sudoku
+                for(cell = hyp.cell + 1; cell < ctx->v_size && !pruned; cell++){
+
+                    //find a subsequent cell which does not have a value yet
+                    if(cp_sudoku[cell]) //if the cell has an unchangeable number skip the cell
+                        continue;
+
+                    //find all possibles value which can go in that cell
+                    for(val = ctx->m_size; val >= 1; val--){
+
+                        //if the current number is not valid in this cell skip the number
+                        if(sudoku_is_safe_num(ctx, cell, val)){
+
+                            //if the cell is the last one and a valid number for it was found the sudoku has been solved
+                            if(cell == ctx->last_pos){
+                                cp_sudoku[cell] = val;
+                                if(hooks != NULL && hooks->solved != NULL)
+                                    hooks->solved(ctx);
+                                return 1;
+                            }
+
+                            //insert the safe number for the cell as an hypothesis in the work list
+                            hyp.cell = cell;
+                            hyp.num = val;
+                            insert_head(work, hyp);
+                        }
+                    }
+
+                    break;
+                }
+
+                //hypotheses given away are taken from the bottom of the list, so the first len of them were not part of this subtree
+                outside = len - (int) (ctx->nr_given - given);
+                if(outside < 0)
+                    outside = 0;
+
+                if(work->len == outside){
+                    for(cell = ctx->v_size - 1; cell >= start_pos; cell--)
+                        if(cp_sudoku[cell] > 0){
+                            sudoku_rm_num_masks(ctx, cp_sudoku[cell], cell);
+                            cp_sudoku[cell] = UNASSIGNED;
+                        }
+                    break;
+                }
+
+                //take a new hypothesis from the work list
+                hyp = pop_head(work);
+
+                //clear the sudoku down to the point of that hypothesis
+                for(cell--; cell >= hyp.cell; cell--){
+                    if(cp_sudoku[cell] > 0) {
+                        sudoku_rm_num_masks(ctx, cp_sudoku[cell], cell);
+                        cp_sudoku[cell] = UNASSIGNED;
+                    }
+                }
+            }
+        }
+
+        //the work list is empty, get work from the other solvers or return when the search is over
+        if(hooks == NULL || hooks->refill == NULL || !hooks->refill(ctx))
+            return 0;
+    }
+}
+
+//copy the numbers found by the search into sudoku
+void sudoku_result(SudokuCtx *ctx, int *sudoku){
+    int i;
+
+    for(i = 0; i < ctx->v_size; i++)
+        if(ctx->cp_sudoku[i] != UNCHANGEABLE)
+            sudoku[i] = ctx->cp_sudoku[i];
+}
+
+//when a solver receives a new hypothesis and the corresponding cp_sudoku, then it has to clear all the work
+//that the sender has done after the hypothesis's position
+void sudoku_delete_from(SudokuCtx *ctx, int cell){
+    int i;
+
+    //initialize the masks from the sudoku read from the file
+    sudoku_init_masks(ctx, ctx->sudoku);
+
+    //clear all work done by the sender
+    for(i = ctx->v_size - 1; i >= cell; i--)
+        if(ctx->cp_sudoku[i] > 0)
+            ctx->cp_sudoku[i] = UNASSIGNED;
+
+    //initialize the masks from the cp_sudoku received
+    for(i = 0; i < cell; i++)
+        if(ctx->cp_sudoku[i] > 0)
+            sudoku_update_masks(ctx, ctx->cp_sudoku[i], i);
+}
+
+//initialize the masks from the clues
+void sudoku_init_masks(SudokuCtx *ctx, int *sudoku){
+    int i;
+
+    for(i = 0; i < ctx->m_size; i++){
+        ctx->rows_mask[i]  = UNASSIGNED;
+        ctx->cols_mask[i]  = UNASSIGNED;
+        ctx->boxes_mask[i] = UNASSIGNED;
+    }
+
+    for(i = 0; i < ctx->v_size; i++)
+        if(sudoku[i])
+            sudoku_update_masks(ctx, sudoku[i], i);
+}
+
+//add new number to the masks
+void sudoku_update_masks(SudokuCtx *ctx, int num, int cell){
+    uint64_t new_mask = 1ULL << (num-1);  //convert number found to mask ex: if dim=4x4, 3 = 0100
+    int row = ROW(cell), col = COL(cell);
+
+    ctx->rows_mask[row] |= new_mask;      //to add the new number to the current row's mask use bitwise OR
+    ctx->cols_mask[col] |= new_mask;      //ex row_mask = 0101 ; number to add: 0010 --> row_mask OR num = 0111
+    ctx->boxes_mask[BOX(row, col)] |= new_mask;
+}
+
+//remove number from the masks
+void sudoku_rm_num_masks(SudokuCtx *ctx, int num, int cell){
+    uint64_t num_mask = 1ULL << (num-1);
+    int row = ROW(cell), col = COL(cell);
+
+    ctx->rows_mask[row] ^= num_mask;
+    ctx->cols_mask[col] ^= num_mask;
+    ctx->boxes_mask[BOX(row, col)] ^= num_mask;
+}
+
+//check if a given number is safe in a given cell, i.e. it is in none of the row, column and box masks of the cell
+int sudoku_is_safe_num(SudokuCtx *ctx, int cell, int num){
+    uint64_t masked_num = 1ULL << (num-1);
+    int row = ROW(cell), col = COL(cell);
+
+    return !((ctx->rows_mask[row] | ctx->cols_mask[col] | ctx->boxes_mask[BOX(row, col)]) & masked_num);
+}
+
+//read a whole puzzle file
+int* sudoku_read(const char *path, int *r_size){
+    FILE *fp;
+    long size;
+    char *text;
+    int *sudoku;
+
+    if((fp = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "unable to open file %s\n", path);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+
+    text = (char*) malloc(size + 1);
+    text[fread(text, 1, size, fp)] = '\0';
+    fclose(fp);
+
+    sudoku = sudoku_parse(text, r_size);
+    free(text);
+    if(sudoku == NULL)
+        fprintf(stderr, "invalid puzzle in %s\n", path);
+
+    return sudoku;
+}
+
+//the box size followed by the numbers of the cells, separated by anything but digits.
+//returns NULL when the text holds fewer numbers than cells or a number larger than r_size^2
+int* sudoku_parse(const char *text, int *r_size){
+    int k = -1, v_size = 0, num, limit = 8, *sudoku = NULL;
+    const char *c = text;
+
+    while(*c){
+        if(!isdigit((unsigned char) *c)){
+            c++;
+            continue;
+        }
+        //the digits past the largest legal value (8 for the box size, m_size for a cell) are only skipped
+        for(num = 0; isdigit((unsigned char) *c); c++)
+            if(num <= limit)
+                num = num * 10 + *c - '0';
+
+        if(k < 0){
+            if(num < 1 || num > 8)
+                return NULL;
+            *r_size = num;
+            limit = num * num;
+            v_size = limit * limit;
+            sudoku = (int*) malloc(v_size * sizeof(int));
+        }else if(k < v_size){
+            if(num > limit){
+                free(sudoku);
+                return NULL;
+            }
+            sudoku[k] = num;
+        }
+        k++;
+    }
+
+    if(k < v_size || sudoku == NULL){
+        free(sudoku);
+        return NULL;
+    }
+    return sudoku;
+}
+
+void sudoku_print(int r_size, int *sudoku) {
+    sudoku_fprint(stdout, r_size, sudoku);
+}
+
+void sudoku_fprint(FILE *fp, int r_size, int *sudoku) {
+    int i, m_size = r_size * r_size, v_size = m_size * m_size;
+
+    for (i = 0; i < v_size; i++) {
+        if(i%m_size != m_size - 1){
+            fprintf(fp, "%2d ", sudoku[i]);
+            if (i% r_size == r_size -1)
+                fprintf(fp, "  |  ");
+        }
+        else{
+            fprintf(fp, "%2d\n\n", sudoku[i]);
+            if (i%(m_size*r_size)==(m_size*r_size)-1){
+              for (int j = 0; j<m_size; j++)
+                  fprintf(fp, "----");
+              fprintf(fp, "\n");
+            }
+
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef SUDOKU_H
+#define SUDOKU_H
+
+//libsudoku: the depth first search of the solvers over an explicit context, so that puzzles of
+//different sizes can be solved at the same time by different threads, each with its own context.
+//The buffers of a context are kept between solves and only grow.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "list.h"
+
+#define UNASSIGNED 0
+#define UNCHANGEABLE -1
+
+typedef struct SudokuCtx SudokuCtx;
+
+//hooks of a search sharing its work list with other solvers (sudoku-mpi), NULL members are skipped
+typedef struct{
+    int (*poll)(SudokuCtx *ctx);    //called before every node expansion, returning 1 stops the search
+    int (*refill)(SudokuCtx *ctx);  //called with an empty work list, returns 1 when new work was inserted
+    void (*solved)(SudokuCtx *ctx); //called when the search completes the grid
+    int (*prune)(SudokuCtx *ctx, Item hyp); //called before hyp is expanded, returning 1 skips its subtree
+}SudokuHooks;
+
+struct SudokuCtx{
+    int r_size, m_size, v_size;
+    int cap_m_size;             //largest m_size the buffers were allocated for
+
+    int *sudoku;                //the puzzle being solved, owned by the caller
+    int *cp_sudoku;             //UNCHANGEABLE for the clues, the numbers of the search elsewhere
+    uint64_t *rows_mask, *cols_mask, *boxes_mask;
+    //A work list contains the pairs (cell_id, number) from which serial DFS search must still be performed
+    //(in other words it contains the root values of the unexplored parts of the search tree)
+    List *work;
+    int first_pos, last_pos;    //first and last empty cells, -1 when the grid is full
+
+    long nr_iterations;         //node expansions since sudoku_start
+    long budget;                //search stopped after that many node expansions, 0 for no limit
+    long nr_given;              //hypotheses taken from the bottom of the work list by the hooks
+
+    SudokuHooks *hooks;
+    void *user;                 //left to the caller
+};
+
+SudokuCtx* sudoku_new(void);
+void sudoku_free(SudokuCtx *ctx);
+
+//solve from memory: sudoku holds the (r_size^2)^2 numbers of the puzzle, 0 for the empty cells.
+//returns 1 with the solution written in sudoku, 0 when there is none (clues in conflict included),
+//-1 when the budget ran out and -2 when r_size is not from 1 to 8 or a number not from 0 to r_size^2
+int sudoku_solve(SudokuCtx *ctx, int r_size, int *sudoku);
+int sudoku_valid(int r_size, const int *sudoku);
+
+//puzzles in the format of the input files: the box size followed by the numbers
+int* sudoku_read(const char *path, int *r_size);
+int* sudoku_parse(const char *text, int *r_size);
+void sudoku_print(int r_size, int *sudoku);
+void sudoku_fprint(FILE *fp, int r_size, int *sudoku);
+
+//building blocks of the searches made on top of the library
+void sudoku_start(SudokuCtx *ctx, int r_size, int *sudoku);
+int sudoku_conflict(SudokuCtx *ctx);
+int sudoku_search(SudokuCtx *ctx);
+void sudoku_result(SudokuCtx *ctx, int *sudoku);
+void sudoku_init_masks(SudokuCtx *ctx, int *sudoku);
+void sudoku_update_masks(SudokuCtx *ctx, int num, int cell);
+void sudoku_rm_num_masks(SudokuCtx *ctx, int num, int cell);
+int sudoku_is_safe_num(SudokuCtx *ctx, int cell, int num);
+void sudoku_delete_from(SudokuCtx *ctx, int cell);
+
+#endif
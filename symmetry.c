@@ -0,0 +1,297 @@
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "symmetry.h"
+
+//Solution counting: sudoku-serial --count [-s] file
+//
+//With -s the search visits a single solution of each orbit of the symmetries left intact by the clues:
+// - relabelings of the free numbers (those absent from the clues): in cell order, the free numbers
+//   must first appear in increasing order
+// - permutations of the bands and of the stacks, with or without transposition, mapping every clue on
+//   itself: a grid is kept only if it is not larger than the image of any of them, once the free numbers
+//   of the image are relabeled by first appearance (lex-leader). The test runs every time a row is
+//   completed, on the rows known so far, and on full grids
+//a kept solution then stands for its whole orbit: nr_free! * nr_maps / (number of maps fixing it) solutions.
+
+#define ROW(i) (i)/ctx->m_size
+#define COL(i) (i)%ctx->m_size
+#define VALUE(i) (ctx->cp_sudoku[i] > 0 ? ctx->cp_sudoku[i] : ctx->sudoku[i])
+
+void find_symmetries(SudokuCtx *ctx, Symmetry *sym);
+//solutions found by a count, passed through its search
+typedef struct{
+    unsigned long long nr_solutions, nr_orbits;
+    int saturated;              //nr_solutions went past ULLONG_MAX, it only stands for a lower bound
+}Count;
+
+void count_search(SudokuCtx *ctx, Symmetry *sym, Count *count);
+void count_add(Count *count, unsigned long long weight);
+uint64_t allowed_numbers(SudokuCtx *ctx, Symmetry *sym);
+int image_cmp(SudokuCtx *ctx, int *map, int known, Symmetry *sym);
+int prefix_ok(SudokuCtx *ctx, int known, Symmetry *sym);
+unsigned long long orbit_size(SudokuCtx *ctx, Symmetry *sym);
+
+int count_main(int argc, char *argv[]){
+    int opt, i, r_size, use_symmetry = 0;
+    int *sudoku;
+    SudokuCtx *ctx;
+    Symmetry sym;
+    Count count = {0, 0, 0};
+    Item hyp;
+    clock_t begin = clock();
+
+    while((opt = getopt(argc, argv, "s")) != -1){
+        switch(opt){
+            case 's': use_symmetry = 1; break;
+            default:
+                fprintf(stderr, "usage: sudoku-serial --count [-s] file\n");
+                return 1;
+        }
+    }
+    if(optind != argc - 1){
+        fprintf(stderr, "usage: sudoku-serial --count [-s] file\n");
+        return 1;
+    }
+
+    if((sudoku = sudoku_read(argv[optind], &r_size)) == NULL)
+        return 1;
+    printf("\n     PROBLEM : \n\n");
+    sudoku_print(r_size, sudoku);
+
+    ctx = sudoku_new();
+    sudoku_start(ctx, r_size, sudoku);
+    find_symmetries(ctx, &sym);
+
+    if(sudoku_conflict(ctx))
+        count.nr_solutions = count.nr_orbits = 0;
+    else if(ctx->first_pos < 0)
+        count.nr_solutions = count.nr_orbits = 1;
+    else{
+        uint64_t allowed = use_symmetry ? allowed_numbers(ctx, &sym) : ~0ULL;
+
+        hyp.cell = ctx->first_pos;
+        for(i = ctx->m_size; i >= 1; i--)
+            if(((allowed >> (i - 1)) & 1) && sudoku_is_safe_num(ctx, hyp.cell, i)){
+                hyp.num = i;
+                insert_head(ctx->work, hyp);
+            }
+        count_search(ctx, use_symmetry ? &sym : NULL, &count);
+    }
+
+    if(count.saturated)
+        printf("\n     SOLUTIONS: more than %llu (count saturated)\n", count.nr_solutions);
+    else
+        printf("\n     SOLUTIONS: %llu\n", count.nr_solutions);
+    printf("\n ****count: %ld nodes, %llu solutions visited, symmetry breaking %s (%d free numbers, %d grid symmetries), %f s\n\n",
+           ctx->nr_iterations, count.nr_orbits, use_symmetry ? "on" : "off", sym.nr_free, sym.nr_maps, (double) (clock() - begin) / CLOCKS_PER_SEC);
+
+    sudoku_free(ctx);
+    free(sym.maps);
+    free(sudoku);
+
+    return 0;
+}
+
+//depth first search over every completion of the clues, same work list as sudoku_search
+void count_search(SudokuCtx *ctx, Symmetry *sym, Count *count){
+    int cell, next, val, len, start_pos;
+    int *cp_sudoku = ctx->cp_sudoku;
+    unsigned long long weight;
+    uint64_t allowed;
+    List *work = ctx->work;
+    Item hyp;
+
+    while(work->head != NULL){
+        hyp = pop_head(work);
+        len = work->len;
+        start_pos = hyp.cell;
+
+        while(1){
+            ctx->nr_iterations++;
+            sudoku_update_masks(ctx, hyp.num, hyp.cell);
+            cp_sudoku[hyp.cell] = hyp.num;
+            cell = hyp.cell;
+
+            if(cell == ctx->last_pos){
+                //a full grid, counted with its orbit
+                weight = sym ? orbit_size(ctx, sym) : 1;
+                if(weight)
+                    count_add(count, weight);
+            }else{
+                for(next = cell + 1; cp_sudoku[next]; next++);
+
+                //a row has just been completed: drop the grid if an image of it is already smaller
+                if(!sym || ROW(next) == ROW(cell) || prefix_ok(ctx, next, sym)){
+                    allowed = sym ? allowed_numbers(ctx, sym) : ~0ULL;
+                    for(val = ctx->m_size; val >= 1; val--)
+                        if(((allowed >> (val - 1)) & 1) && sudoku_is_safe_num(ctx, next, val)){
+                            hyp.cell = next;
+                            hyp.num = val;
+                            insert_head(work, hyp);
+                        }
+                }
+            }
+
+            //the subtree of the hypothesis is exhausted: undo it
+            if(work->len == len){
+                for(; cell >= start_pos; cell--)
+                    if(cp_sudoku[cell] > 0){
+                        sudoku_rm_num_masks(ctx, cp_sudoku[cell], cell);
+                        cp_sudoku[cell] = UNASSIGNED;
+                    }
+                break;
+            }
+
+            //take a new hypothesis and clear the sudoku down to its cell
+            hyp = pop_head(work);
+            for(; cell >= hyp.cell; cell--)
+                if(cp_sudoku[cell] > 0){
+                    sudoku_rm_num_masks(ctx, cp_sudoku[cell], cell);
+                    cp_sudoku[cell] = UNASSIGNED;
+                }
+        }
+    }
+}
+
+//a kept grid and the solutions it stands for, ULLONG_MAX standing for an orbit too large to count
+void count_add(Count *count, unsigned long long weight){
+    count->nr_orbits++;
+    if(weight == ULLONG_MAX || __builtin_add_overflow(count->nr_solutions, weight, &count->nr_solutions)){
+        count->nr_solutions = ULLONG_MAX;
+        count->saturated = 1;
+    }
+}
+
+//numbers the next cell may take without breaking the first appearance order of the free numbers:
+//the numbers of the clues, the free numbers already placed and the first free number not placed yet
+uint64_t allowed_numbers(SudokuCtx *ctx, Symmetry *sym){
+    int i, placed;
+    uint64_t used = 0, allowed = ~sym->free_mask;
+
+    for(i = 0; i < ctx->m_size; i++)
+        used |= ctx->rows_mask[i];
+    placed = __builtin_popcountll(used & sym->free_mask);
+
+    for(i = 0; i <= placed && i < sym->nr_free; i++)
+        allowed |= 1ULL << (sym->free_num[i] - 1);
+    return allowed;
+}
+
+//compare the image of the grid by a map, its free numbers relabeled by first appearance, with the grid
+//itself on the first known cells: -1 if the image is smaller, 1 if it is larger, 0 if equal as far as known
+int image_cmp(SudokuCtx *ctx, int *map, int known, Symmetry *sym){
+    int i, src, a, b, next = 0;
+    int label[65] = {0};
+
+    for(i = 0; i < known; i++){
+        src = map[i];
+        if(src >= known && !ctx->sudoku[src])
+            return 0;
+
+        a = VALUE(src);
+        if(sym->free_rank[a] >= 0){
+            if(!label[a])
+                label[a] = sym->free_num[next++];
+            a = label[a];
+        }
+        b = VALUE(i);
+        if(a != b)
+            return a < b ? -1 : 1;
+    }
+    return 0;
+}
+
+int prefix_ok(SudokuCtx *ctx, int known, Symmetry *sym){
+    int k;
+
+    //maps[0] is the identity
+    for(k = 1; k < sym->nr_maps; k++)
+        if(image_cmp(ctx, sym->maps + k * ctx->v_size, known, sym) < 0)
+            return 0;
+    return 1;
+}
+
+//number of solutions a full grid stands for, 0 if a smaller grid of its orbit is counted instead
+//and ULLONG_MAX if there are too many of them
+unsigned long long orbit_size(SudokuCtx *ctx, Symmetry *sym){
+    int k, cmp, fixed = 0;
+    unsigned long long weight;
+
+    for(k = 0; k < sym->nr_maps; k++){
+        cmp = image_cmp(ctx, sym->maps + k * ctx->v_size, ctx->v_size, sym);
+        if(cmp < 0)
+            return 0;
+        if(!cmp)
+            fixed++;
+    }
+    //the maps form a group and those fixing the grid a subgroup of it, so fixed divides nr_maps
+    if(sym->kfact == ULLONG_MAX || __builtin_mul_overflow(sym->kfact, (unsigned long long) (sym->nr_maps / fixed), &weight))
+        return ULLONG_MAX;
+    return weight;
+}
+
+//free numbers of the clues and the band/stack permutations (with or without transposition) keeping them.
+//Grid permutations are only looked for up to 16x16, past that there are too many of them
+void find_symmetries(SudokuCtx *ctx, Symmetry *sym){
+    int i, j, k, t, a, b, row, col, src, ok, nr_perms = 1;
+    int r_size = ctx->r_size, m_size = ctx->m_size, v_size = ctx->v_size, *sudoku = ctx->sudoku;
+    int *perms, *map;
+    uint64_t clues = 0;
+
+    for(i = 0; i < v_size; i++)
+        if(sudoku[i])
+            clues |= 1ULL << (sudoku[i] - 1);
+
+    sym->free_mask = 0;
+    sym->nr_free = 0;
+    sym->kfact = 1;
+    for(i = 1; i <= m_size; i++){
+        sym->free_rank[i] = -1;
+        if(!((clues >> (i - 1)) & 1)){
+            sym->free_mask |= 1ULL << (i - 1);
+            sym->free_rank[i] = sym->nr_free;
+            sym->free_num[sym->nr_free++] = i;
+            if(__builtin_mul_overflow(sym->kfact, sym->nr_free, &sym->kfact))
+                sym->kfact = ULLONG_MAX;
+        }
+    }
+    sym->free_rank[0] = -1;
+
+    if(r_size <= 4)
+        for(i = 2; i <= r_size; i++)
+            nr_perms *= i;
+
+    //every permutation of r_size elements, the first one is the identity
+    perms = (int*) malloc(nr_perms * r_size * sizeof(int));
+    for(k = 0; k < nr_perms; k++){
+        int *perm = perms + k * r_size, code = k;
+        for(i = 0; i < r_size; i++)
+            perm[i] = i;
+        for(i = 0; i < r_size && nr_perms > 1; i++){
+            j = i + code % (r_size - i);
+            code /= r_size - i;
+            t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+        }
+    }
+
+    sym->nr_maps = 0;
+    sym->maps = (int*) malloc(2 * nr_perms * nr_perms * v_size * sizeof(int));
+    for(t = 0; t < (nr_perms > 1 ? 2 : 1); t++)
+        for(a = 0; a < nr_perms; a++)
+            for(b = 0; b < nr_perms; b++){
+                map = sym->maps + sym->nr_maps * v_size;
+                ok = 1;
+                for(i = 0; i < v_size && ok; i++){
+                    row = perms[a * r_size + ROW(i) / r_size] * r_size + ROW(i) % r_size;
+                    col = perms[b * r_size + COL(i) / r_size] * r_size + COL(i) % r_size;
+                    src = t ? col * m_size + row : row * m_size + col;
+                    map[i] = src;
+                    ok = sudoku[src] == sudoku[i];
+                }
+                if(ok)
+                    sym->nr_maps++;
+            }
+
+    free(perms);
+}
@@ -0,0 +1,14 @@
+#include "sudoku.h"
+
+//symmetries of the clues, used to count the solutions of sparse puzzles one orbit at a time
+typedef struct{
+    uint64_t free_mask;         //numbers absent from the clues, any relabeling of them maps solutions to solutions
+    int nr_free;
+    int free_rank[65];          //position of a free number in increasing order, -1 for the numbers of the clues
+    int free_num[64];           //the free numbers in increasing order
+    int nr_maps;
+    int *maps;                  //nr_maps grid permutations keeping the clues: cell i of the image is cell maps[k*v_size+i]
+    unsigned long long kfact;   //nr_free!, ULLONG_MAX when it does not fit
+}Symmetry;
+
+int count_main(int argc, char *argv[]);